@@ -1,5 +1,7 @@
 #include "avreadwrite.h"
 
+#include <algorithm> // clamp, max
+
 
 void errLog(const char * file, int line, std::string msg, int avError)
 {
@@ -20,6 +22,60 @@ void errLog(const char * file, int line, std::string msg, int avError)
 }
 
 
+bool frameGrayImage(const AVFrame* frame, cv::Mat& grayImage)
+{
+    if (!frame->width || !frame->height) {
+        return false;
+    } else {
+        // Y plane w/o copy, rows are padded by decoder: step = linesize
+        cv::Size frameSize(frame->width, frame->height);
+        grayImage = cv::Mat(frameSize, CV_8UC1, frame->data[0],
+                            static_cast<size_t>(frame->linesize[0]));
+        return true;
+    }
+}
+
+
+bool frameMotionVectors(const AVFrame* frame, cv::Mat& mvMagnitude, int pastDistance, int futureDistance)
+{
+    if (!frame->width || !frame->height) {
+        return false;
+    }
+    AVFrameSideData* sideData = av_frame_get_side_data(frame, AV_FRAME_DATA_MOTION_VECTORS);
+    if (!sideData) {
+        return false;
+    }
+
+    // macroblock grid of frame
+    const int mbSize = 16;
+    int mbCols = (frame->width + mbSize - 1) / mbSize;
+    int mbRows = (frame->height + mbSize - 1) / mbSize;
+    mvMagnitude.create(mbRows, mbCols, CV_32F);
+    mvMagnitude.setTo(cv::Scalar(0));
+
+    // partitions (16x16 ... 4x4) -> max magnitude of macroblock
+    // per frame: divided by distance to reference (b-frames, p-frames after skipped b-frames)
+    const float pastScale = 1.0f / std::max(pastDistance, 1);
+    const float futureScale = 1.0f / std::max(futureDistance, 1);
+    const AVMotionVector* mvs = reinterpret_cast<const AVMotionVector*>(sideData->data);
+    size_t nMvs = static_cast<size_t>(sideData->size) / sizeof(AVMotionVector);
+    for (size_t n = 0; n < nMvs; ++n) {
+        const AVMotionVector& mv = mvs[n];
+        if (!mv.motion_scale) continue;
+        float magnitude = std::sqrt(static_cast<float>(mv.motion_x * mv.motion_x + mv.motion_y * mv.motion_y))
+                / mv.motion_scale * (mv.source < 0 ? pastScale : futureScale);
+
+        // dst_x, dst_y: center of block in current frame
+        int col = (mv.dst_x - mv.w / 2) / mbSize;
+        int row = (mv.dst_y - mv.h / 2) / mbSize;
+        if (col < 0 || col >= mbCols || row < 0 || row >= mbRows) continue;
+        float& mbMagnitude = mvMagnitude.at<float>(row, col);
+        mbMagnitude = magnitude > mbMagnitude ? magnitude : mbMagnitude;
+    }
+    return true;
+}
+
+
 void printAVErrorCodes()
 {
     std::map<std::string, int> errorCodes;
@@ -42,7 +98,23 @@ LibavDecoder::LibavDecoder() :
     m_codec(nullptr),
     m_codecCtx(nullptr),
     m_codecParams(nullptr),
-    m_frame(nullptr)
+    m_decodeFrames(DecodeFrames::all),
+    m_exportMotionVectors(false),
+    m_frame(nullptr),
+    m_frameRecv(nullptr),
+    m_framesReceived(0),
+    m_futureDistance(1),
+    m_hasDecodeError(false),
+    m_lastPts(AV_NOPTS_VALUE),
+    m_lowres(0),
+    m_packetsSent(0),
+    m_pastDistance(1),
+    m_ptsStep(0),
+    m_quality(DecodeQuality::full),
+    m_refInterval(1),
+    m_refPts(AV_NOPTS_VALUE),
+    m_threadCount(1),
+    m_threadType(DecodeThreading::none)
 {
     avcodec_register_all();
 }
@@ -59,6 +131,7 @@ void LibavDecoder::close()
 {
 
     av_frame_free(&m_frame);
+    av_frame_free(&m_frameRecv);
 
     // free open or closed codecs
     // https://ffmpeg.org/doxygen/trunk/group__lavc__core.html#gaf869d0829ed607cec3a4a02a1c7026b3
@@ -66,32 +139,131 @@ void LibavDecoder::close()
 }
 
 
+// delay is measured again with changed frame selection
+void LibavDecoder::decodeFrames(DecodeFrames frames)
+{
+    if (frames != m_decodeFrames) {
+        m_framesReceived = 0;
+        m_packetsSent = 0;
+    }
+    m_decodeFrames = frames;
+    if (!m_codecCtx)
+        return;
+
+    switch (m_decodeFrames) {
+    case DecodeFrames::all:
+        m_codecCtx->skip_frame = AVDISCARD_DEFAULT;
+        break;
+    case DecodeFrames::reference:
+        m_codecCtx->skip_frame = AVDISCARD_NONREF;
+        break;
+    case DecodeFrames::key:
+        m_codecCtx->skip_frame = AVDISCARD_NONKEY;
+        break;
+    }
+}
+
+
+DecodeFrames LibavDecoder::decodeFrames() const
+{
+    return m_decodeFrames;
+}
+
+
 bool LibavDecoder::decodePacket(AVPacket* packet)
 {
+    m_hasDecodeError = false;
     int ret = avcodec_send_packet(m_codecCtx, packet);
     if (ret < 0) {
         avErrMsg("Failed to send packet to decoder", ret);
+        m_hasDecodeError = true;
         return false;
     }
-
-    ret = avcodec_receive_frame(m_codecCtx, m_frame);
-    if (ret == 0) {
-        return true; // frame available
-    } else if (ret != AVERROR(EAGAIN)) {
+    // skipped frames (skip_frame) never return: delay measured while decoding all frames
+    if (m_decodeFrames == DecodeFrames::all)
+        ++m_packetsSent;
+
+    /* frame threading: the decoder returns frames with a delay of
+     * up to (threadCount - 1) packets, usually one frame per packet in steady state
+     * receive into separate frame in order to keep last decoded frame on EAGAIN */
+    bool isFrameAvailable = false;
+    while ((ret = avcodec_receive_frame(m_codecCtx, m_frameRecv)) == 0) {
+        av_frame_unref(m_frame);
+        av_frame_move_ref(m_frame, m_frameRecv);
+        updateRefDistance();
+        if (m_decodeFrames == DecodeFrames::all)
+            ++m_framesReceived;
+        isFrameAvailable = true;
+    }
+    if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
         avErrMsg("Failed to receive frame from decoder", ret);
+        m_hasDecodeError = true;
+        // packets without frame: delay measured again
+        m_framesReceived = 0;
+        m_packetsSent = 0;
         return false;
     }
 
-    return false; // no frame was returned, read next packet
+    return isFrameAvailable; // false: no frame was returned, read next packet
+}
+
+
+void LibavDecoder::exportMotionVectors(bool value)
+{
+    m_exportMotionVectors = value;
+}
+
+
+bool LibavDecoder::exportMotionVectors() const
+{
+    return m_exportMotionVectors;
+}
+
+
+// frames of idle mode still in flight may return after counters were reset
+// bounded by frame threading depth: packets dropped by decoder do not count
+int LibavDecoder::frameDelay() const
+{
+    int64_t depth = threadType() == DecodeThreading::frame ? std::max(threadCount() - 1, 0) : 0;
+    return static_cast<int>(std::clamp<int64_t>(m_packetsSent - m_framesReceived, 0, depth));
+}
+
+
+int LibavDecoder::futureRefDistance() const
+{
+    return m_futureDistance;
 }
 
 
 double LibavDecoder::frameTime(AVRational timeBase)
 {
-    if (m_frame) {
-        return (static_cast<double>(m_frame->pts) * timeBase.num / timeBase.den);
+    if (!m_frame)
+        return -1;
+    int64_t pts = m_frame->pts != AV_NOPTS_VALUE ? m_frame->pts : m_frame->best_effort_timestamp;
+    if (pts == AV_NOPTS_VALUE)
+        return -1;
+    return (static_cast<double>(pts) * timeBase.num / timeBase.den);
+}
+
+
+bool LibavDecoder::hasDecodeError() const
+{
+    return m_hasDecodeError;
+}
+
+
+void LibavDecoder::lowres(int value)
+{
+    m_lowres = value < 0 ? 0 : value;
+}
+
+
+int LibavDecoder::lowres() const
+{
+    if (m_codecCtx) {
+        return m_codecCtx->lowres;
     } else {
-        return 0;
+        return m_quality == DecodeQuality::detection ? m_lowres : 0;
     }
 }
 
@@ -120,6 +292,42 @@ int LibavDecoder::open(AVCodecParameters* vCodecParams)
         return ret;
     }
 
+    // multithreaded decoding, thread_count = 0 -> libavcodec detects number of cores
+    m_codecCtx->thread_count = m_threadCount;
+    switch (m_threadType) {
+    case DecodeThreading::frame:
+        m_codecCtx->thread_type = FF_THREAD_FRAME;
+        break;
+    case DecodeThreading::slice:
+        m_codecCtx->thread_type = FF_THREAD_SLICE;
+        break;
+    case DecodeThreading::none:
+        m_codecCtx->thread_count = 1;
+        break;
+    }
+
+    // detection grade decoding: motion detection is the only consumer of decoded
+    // frames (recording is stream-copied) -> trade picture quality for cpu time
+    if (m_quality == DecodeQuality::detection) {
+        // lowres: h264 does not support it (max_lowres = 0), mjpeg, mpeg4 do
+        m_codecCtx->lowres = m_lowres > m_codec->max_lowres ? m_codec->max_lowres : m_lowres;
+        m_codecCtx->skip_loop_filter = AVDISCARD_ALL;
+        m_codecCtx->skip_idct = AVDISCARD_NONREF;
+        m_codecCtx->flags |= AV_CODEC_FLAG_GRAY; // luma only, if built with gray support
+        m_codecCtx->flags2 |= AV_CODEC_FLAG2_FAST;
+    }
+
+    // motion vectors as side data of decoded frame (AV_FRAME_DATA_MOTION_VECTORS)
+    // pixels are not analysed: residual (idct) and loop filter skipped, where the codec
+    // honours it (mpeg2, mpeg4; h264 skips the loop filter only), motion compensation
+    // cannot be skipped, vectors are exported while the frame is reconstructed
+    if (m_exportMotionVectors) {
+        m_codecCtx->flags2 |= AV_CODEC_FLAG2_EXPORT_MVS | AV_CODEC_FLAG2_FAST;
+        m_codecCtx->skip_idct = AVDISCARD_ALL;
+        m_codecCtx->skip_loop_filter = AVDISCARD_ALL;
+        m_codecCtx->flags |= AV_CODEC_FLAG_GRAY;
+    }
+
     ret = avcodec_open2(m_codecCtx, m_codec, nullptr);
     if (ret < 0) {
         avErrMsg("Failed to open codec", ret);
@@ -127,25 +335,126 @@ int LibavDecoder::open(AVCodecParameters* vCodecParams)
         return ret;
     }
 
+    // apply skip_frame setting requested before open
+    decodeFrames(m_decodeFrames);
+
     m_frame = av_frame_alloc();
-    if (!m_frame) {
+    m_frameRecv = av_frame_alloc();
+    if (!m_frame || !m_frameRecv) {
         avErrMsg("Failed to allocate memory for AVFrame");
+        av_frame_free(&m_frame);
+        av_frame_free(&m_frameRecv);
         avcodec_free_context(&m_codecCtx);
         return -1;
     }
 
+    m_framesReceived = 0;
+    m_packetsSent = 0;
+    m_futureDistance = 1;
+    m_lastPts = AV_NOPTS_VALUE;
+    m_pastDistance = 1;
+    m_ptsStep = 0;
+    m_refInterval = 1;
+    m_refPts = AV_NOPTS_VALUE;
     return 0;
 }
 
 
+int LibavDecoder::pastRefDistance() const
+{
+    return m_pastDistance;
+}
+
+
+void LibavDecoder::quality(DecodeQuality value)
+{
+    m_quality = value;
+}
+
+
+DecodeQuality LibavDecoder::quality() const
+{
+    return m_quality;
+}
+
+
 bool LibavDecoder::retrieveFrame(cv::Mat& grayImage)
 {
-    if (!m_frame->width || !m_frame->height) {
+    return frameGrayImage(m_frame, grayImage);
+}
+
+
+bool LibavDecoder::retrieveFrame(AVFrame* frame)
+{
+    if (!m_frame->width || !m_frame->height)
         return false;
+    return av_frame_ref(frame, m_frame) == 0;
+}
+
+
+bool LibavDecoder::retrieveMotionVectors(cv::Mat& mvMagnitude)
+{
+    return frameMotionVectors(m_frame, mvMagnitude, m_pastDistance, m_futureDistance);
+}
+
+
+void LibavDecoder::threadCount(int count)
+{
+    m_threadCount = count < 0 ? 0 : count;
+}
+
+
+int LibavDecoder::threadCount() const
+{
+    return m_codecCtx ? m_codecCtx->thread_count : m_threadCount;
+}
+
+
+void LibavDecoder::threadType(DecodeThreading type)
+{
+    m_threadType = type;
+}
+
+
+DecodeThreading LibavDecoder::threadType() const
+{
+    // codec may not support requested threading type
+    if (m_codecCtx) {
+        if (m_codecCtx->active_thread_type & FF_THREAD_FRAME)
+            return DecodeThreading::frame;
+        else if (m_codecCtx->active_thread_type & FF_THREAD_SLICE)
+            return DecodeThreading::slice;
+        else
+            return DecodeThreading::none;
     } else {
-        cv::Size frameSize(m_frame->width, m_frame->height);
-        grayImage = cv::Mat(frameSize, CV_8UC1, m_frame->data[0]);
-        return true;
+        return m_threadType;
+    }
+}
+
+
+/* frames output in display order: past reference of frame is last reference frame output
+ * (p-frame: may reference older frames, nearest assumed), future reference of b-frame
+ * assumed at reference interval of stream (distance between last two reference frames)
+ * frame duration in pts: smallest increment of frames output */
+void LibavDecoder::updateRefDistance()
+{
+    int64_t pts = m_frame->pts != AV_NOPTS_VALUE ? m_frame->pts : m_frame->best_effort_timestamp;
+    if (pts == AV_NOPTS_VALUE)
+        return;
+    if (m_lastPts != AV_NOPTS_VALUE && pts > m_lastPts)
+        m_ptsStep = m_ptsStep > 0 ? std::min(m_ptsStep, pts - m_lastPts) : pts - m_lastPts;
+    m_lastPts = pts;
+
+    m_pastDistance = 1;
+    if (m_ptsStep > 0 && m_refPts != AV_NOPTS_VALUE && pts > m_refPts)
+        m_pastDistance = static_cast<int>(std::min<int64_t>((pts - m_refPts + m_ptsStep / 2) / m_ptsStep, 1000));
+    if (m_frame->pict_type == AV_PICTURE_TYPE_B) {
+        m_futureDistance = std::max(m_refInterval - m_pastDistance, 1);
+    } else {
+        if (m_frame->pict_type == AV_PICTURE_TYPE_P)
+            m_refInterval = m_pastDistance;
+        m_futureDistance = 1;
+        m_refPts = pts;
     }
 }
 
@@ -323,6 +632,16 @@ bool LibavReader::readVideoPacket(AVPacket*& pkt)
 }
 
 
+int64_t LibavReader::startTimeRealtime()
+{
+    if (m_idxVideoStream >= 0) {
+        return m_inCtx->start_time_realtime;
+    } else {
+        return AV_NOPTS_VALUE;
+    }
+}
+
+
 
 /*** LibavWriter *************************************************************/
 
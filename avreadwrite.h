@@ -4,6 +4,7 @@
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
+#include <libavutil/motion_vector.h>
 }
 #include <opencv2/opencv.hpp>
 
@@ -19,6 +20,29 @@ void errLog(const char * file, int line, std::string msg, int error = 0);
 
 void printAVErrorCodes();
 
+/* Y plane of frame as gray image w/o copy, valid while frame is referenced
+ * false: frame empty */
+bool frameGrayImage(const AVFrame* frame, cv::Mat& grayImage);
+/* max. motion vector magnitude in pixels per frame per 16x16 macroblock (CV_32F)
+ * vectors divided by distance in frames to their reference (past or future)
+ * false: no motion vectors available (intra frame or export disabled) */
+bool frameMotionVectors(const AVFrame* frame, cv::Mat& mvMagnitude,
+                        int pastDistance = 1, int futureDistance = 1);
+
+enum class DecodeFrames {all, reference, key};
+enum class DecodeQuality {full, detection};
+enum class DecodeThreading {none, frame, slice};
+
+struct DecoderParams
+{
+    DecodeFrames        idleFrames;  // frames to decode while motion detector is idle
+    int                 lowres;      // detection quality: decode at 1/2^lowres, if supported by codec
+    DecodeQuality       quality;
+    int                 threadCount; // 0: auto (number of cores), 1: single thread
+    DecodeThreading     threadType;
+    char                avoidPaddingWarning1[4];
+};
+
 struct VideoStream
 {
     AVCodecParameters*      videoCodecParameters;
@@ -32,15 +56,74 @@ public:
     LibavDecoder();
     ~LibavDecoder();
     void                close();
+    /* skip frames by codec (skip_frame), can be changed while decoding
+     * reference: skip non-reference frames, key: decode key frames only */
+    void                decodeFrames(DecodeFrames frames);
+    DecodeFrames        decodeFrames() const;
+    /* export motion vectors as frame side data, must be set before open
+     * pixels are not analysed: idct and loop filter skipped (as far as codec supports),
+     * frames are still reconstructed (motion compensation), retrieved images are degraded */
+    void                exportMotionVectors(bool value);
+    bool                exportMotionVectors() const;
+    /* returns true, if a new frame is available
+     * false: decoder needs more input or decoding failed (see hasDecodeError) */
     bool                decodePacket(AVPacket* packet);
+    /* number of frames the decoder lags behind its input (packets sent - frames received)
+     * frame threading adds up to threadCount - 1 frames, without frame threading 0
+     * measured while all frames are decoded, restarts with decodeFrames or decode error */
+    int                 frameDelay() const;
+    /* presentation time of last frame in seconds, pts or best effort time stamp
+     * -1: no frame or no time stamp */
     double              frameTime(AVRational timeBase);
+    /* distance in frames of last frame to its future reference (b-frame), else 1 */
+    int                 futureRefDistance() const;
+    bool                hasDecodeError() const;
+    /* lowres must be set before open, getter returns active value after open
+     * (0, if not supported by codec) */
+    void                lowres(int value);
+    int                 lowres() const;
     int                 open(AVCodecParameters* vCodecParams);
+    /* distance in frames of last frame to its past reference (nearest reference frame output) */
+    int                 pastRefDistance() const;
+    /* detection: frames are used for motion detection only
+     * -> lowres, skip loop filter, skip idct for non-ref frames, fast flags
+     * must be set before open */
+    void                quality(DecodeQuality value);
+    DecodeQuality       quality() const;
     bool                retrieveFrame(cv::Mat& grayImage);
+    /* reference to last decoded frame (av_frame_ref, no copy): stays valid for other thread,
+     * decoder continues with new buffer, false: no frame or reference failed */
+    bool                retrieveFrame(AVFrame* frame);
+    /* max. motion vector magnitude in pixels per frame per 16x16 macroblock (CV_32F)
+     * false: no motion vectors available (intra frame or export disabled) */
+    bool                retrieveMotionVectors(cv::Mat& mvMagnitude);
+    /* threading must be set before open, getters return active values after open */
+    void                threadCount(int count);
+    int                 threadCount() const;
+    void                threadType(DecodeThreading type);
+    DecodeThreading     threadType() const;
 private:
+    void                updateRefDistance();
     AVCodec             *m_codec;
     AVCodecContext      *m_codecCtx;
     AVCodecParameters   *m_codecParams;
-    AVFrame             *m_frame;
+    DecodeFrames        m_decodeFrames;
+    bool                m_exportMotionVectors;
+    AVFrame             *m_frame;       // last decoded frame
+    AVFrame             *m_frameRecv;   // receive buffer, moved to m_frame on success
+    int64_t             m_framesReceived;
+    int                 m_futureDistance;   // frames to future reference of last frame
+    bool                m_hasDecodeError;
+    int64_t             m_lastPts;
+    int                 m_lowres;
+    int64_t             m_packetsSent;
+    int                 m_pastDistance;     // frames to past reference of last frame
+    int64_t             m_ptsStep;          // frame duration in pts, 0: unknown
+    DecodeQuality       m_quality;
+    int                 m_refInterval;      // frames between last two reference frames
+    int64_t             m_refPts;           // of last reference frame output
+    int                 m_threadCount;
+    DecodeThreading     m_threadType;
 };
 
 class LibavReader
@@ -57,6 +140,9 @@ public:
     int                 open(std::string file);
     bool                playStream();
     bool                readVideoPacket(AVPacket*& pkt);
+    /* wall clock time of stream start in microseconds (rtsp: from RTCP sender report)
+     * AV_NOPTS_VALUE, if unknown */
+    int64_t             startTimeRealtime();
 private:
     AVFormatContext*    m_inCtx;
     int                 m_idxVideoStream; // assumption: there is only one video stream
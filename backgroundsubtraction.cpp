@@ -1,4 +1,5 @@
 #include "backgroundsubtraction.h"
+#include "detection-kernels.h"
 
 
 /// background subtractor: first order low pass filter
@@ -9,7 +10,10 @@ cv::Ptr<BackgroundSubtractorLowPass> createBackgroundSubtractorLowPass(double al
 
 BackgroundSubtractorLowPass::BackgroundSubtractorLowPass(double alpha, double threshold) : 
 	m_alpha(alpha), 
+	m_foregroundCount(0),
 	m_isInitialized(false),
+    m_model(BackgroundModel::float32),
+    m_stats{cv::Mat(), cv::Mat(), cv::Mat(), cv::Mat(), std::vector<int>(), 16, {0}},
     m_threshold(threshold)
 {
 }
@@ -20,37 +24,113 @@ BackgroundSubtractorLowPass::~BackgroundSubtractorLowPass()
 }
 
 
+double BackgroundSubtractorLowPass::alpha() const
+{
+    return m_alpha;
+}
+
+
+void BackgroundSubtractorLowPass::alpha(double alpha)
+{
+    m_alpha = alpha;
+}
+
+
 void BackgroundSubtractorLowPass::apply(cv::InputArray image, cv::OutputArray fgmask, double learningRate)
 {
-    std::ignore = learningRate;
-	// fill accu when applying for first time
-	if (!m_isInitialized) {
-		m_accu = cv::Mat(image.size(), CV_32F);
-		image.getMat().convertTo(m_accu, CV_32F);
-		fgmask.assign(cv::Mat(image.size(), CV_8UC1));
+    double alpha = learningRate < 0 ? m_alpha : learningRate;
+	// fill accu when applying for first time or after frame size changed (roi)
+	if (!m_isInitialized || image.size() != m_accu.size()) {
+        if (m_model == BackgroundModel::fixed16) {
+            image.getMat().convertTo(m_accu, CV_16U, 256);
+        } else {
+            image.getMat().convertTo(m_accu, CV_32F);
+        }
+		fgmask.assign(cv::Mat(image.size(), CV_8UC1, cv::Scalar(0)));
+		m_foregroundCount = 0;
+		int cellSize = m_stats.cellSize;
+		if (cellSize > 0) {
+			m_stats.cells.create((image.size().height + cellSize - 1) / cellSize,
+			                     (image.size().width + cellSize - 1) / cellSize, CV_32S);
+			m_stats.cells.setTo(cv::Scalar(0));
+		} else {
+			m_stats.cells.release();
+		}
+		m_stats.zoneCounts.assign(UCHAR_MAX + 1, 0);
 		m_isInitialized = true;
 	// actual segmentation algorithm
 	} else { 
-		cv::accumulateWeighted(image, m_accu, m_alpha);
-		cv::Mat accu8U;
-		cv::convertScaleAbs(m_accu, accu8U);
-		cv::absdiff(image, accu8U, fgmask);
-        /* yuv image is one channel gray already */
-        //cv::cvtColor(fgmask, fgmask, cv::COLOR_BGR2GRAY);
-        cv::threshold(fgmask, fgmask, m_threshold, UCHAR_MAX, cv::THRESH_BINARY);
+        /* yuv image is one channel gray already
+         * accumulateWeighted, convertScaleAbs, absdiff, threshold and countNonZero
+         * in one sweep, bit compatible with opencv functions */
+        fgmask.create(image.size(), CV_8UC1);
+        cv::Mat mask = fgmask.getMat();
+        // zone maps of other frame size (roi or scale changed) are not applied
+        if (m_stats.labels.size() != image.size()) {
+            m_stats.labels.release();
+            m_stats.thresholds.release();
+        }
+        if (m_model == BackgroundModel::fixed16) {
+            // alpha = 2^-shift, nearest in log scale
+            int shift = alpha > 0 ? cvRound(-std::log2(alpha)) : 15;
+            m_foregroundCount = lowPassSegmentQ8(image.getMat(), m_accu, mask, shift, m_threshold, m_stats);
+        } else {
+            m_foregroundCount = lowPassSegment(image.getMat(), m_accu, mask, alpha, m_threshold, m_stats);
+        }
 	}
 
 	return;
 }
 
 
+cv::Mat BackgroundSubtractorLowPass::cellCounts() const
+{
+    return m_stats.cells;
+}
+
+
+int BackgroundSubtractorLowPass::cellSize() const
+{
+    return m_stats.cellSize;
+}
+
+
+void BackgroundSubtractorLowPass::cellSize(int size)
+{
+    m_stats.cellSize = size < 0 ? 0 : size;
+    m_stats.cells.release();
+}
+
+
+int BackgroundSubtractorLowPass::foregroundCount() const
+{
+    return m_foregroundCount;
+}
+
+
 void BackgroundSubtractorLowPass::getBackgroundImage(cv::OutputArray backgroundImage) const
 {
-	m_accu.convertTo(backgroundImage, CV_8U);
+    double scale = m_model == BackgroundModel::fixed16 ? 1.0 / 256 : 1.0;
+	m_accu.convertTo(backgroundImage, CV_8U, scale);
 	return;
 }
 
 
+BackgroundModel BackgroundSubtractorLowPass::model() const
+{
+    return m_model;
+}
+
+
+void BackgroundSubtractorLowPass::model(BackgroundModel model)
+{
+    if (model != m_model) {
+        m_model = model;
+        m_isInitialized = false;
+    }
+}
+
+
 double BackgroundSubtractorLowPass::threshold() const
 {
     return m_threshold;
@@ -61,3 +141,17 @@ void BackgroundSubtractorLowPass::threshold(double threshold)
 {
     m_threshold = threshold;
 }
+
+
+const std::vector<int>& BackgroundSubtractorLowPass::zoneCounts() const
+{
+    return m_stats.zoneCounts;
+}
+
+
+void BackgroundSubtractorLowPass::zoneMap(cv::Mat labels, cv::Mat thresholds)
+{
+    CV_Assert(labels.empty() || labels.size() == thresholds.size());
+    m_stats.labels = labels;
+    m_stats.thresholds = thresholds;
+}
@@ -1,20 +1,54 @@
 #ifndef BACKGROUNDSUBTRACTION_H
 #define BACKGROUNDSUBTRACTION_H
+#include "detection-kernels.h"
+
 #include <opencv2/opencv.hpp>
 
+/* background accumulator
+ * float32: CV_32F, alpha as given
+ * fixed16: Q8.8 in CV_16U, alpha rounded to power of two (log scale),
+ *          half the memory traffic, twice the lanes per simd register
+ *          alpha 0.005 -> 1/256, threshold 50: compared to float32
+ *          0.1% of mask pixels differ, foreground count approx. 2% higher
+ *          (slower adaption behind moving objects), background stops adapting
+ *          within +/- 1 gray level (truncated update) */
+enum class BackgroundModel {float32, fixed16};
+
 /// background subtractor: first order low pass filter
 class BackgroundSubtractorLowPass : public cv::BackgroundSubtractor {
 public:
 	BackgroundSubtractorLowPass(double alpha, double threshold);
 	~BackgroundSubtractorLowPass();
+    double       alpha() const;
+    void         alpha(double alpha);
+    /* learningRate < 0: use alpha
+     * update and segmentation fused in one pass (detection-kernels) */
 	virtual void apply(cv::InputArray image, cv::OutputArray fgmask, double learningRate=-1);
+    /* foreground count per cellSize x cellSize block of last applied frame (CV_32S)
+     * counted in same pass as segmentation, cellSize 0: no cells */
+    cv::Mat      cellCounts() const;
+    int          cellSize() const;
+    void         cellSize(int size);
+    /* number of foreground pixels of last applied frame */
+    int          foregroundCount() const;
 	virtual void getBackgroundImage(cv::OutputArray backgroundImage) const;
+    /* change of model restarts learning with next frame */
+    BackgroundModel model() const;
+    void         model(BackgroundModel model);
     double       threshold() const;
     void         threshold(double threshold);
+    /* foreground count per zone label of last applied frame (256 entries) */
+    const std::vector<int>& zoneCounts() const;
+    /* zone label and threshold per pixel (CV_8U, size of applied frames)
+     * thresholds replace threshold, empty mats: no zones */
+    void         zoneMap(cv::Mat labels, cv::Mat thresholds);
 private:
 	cv::Mat	m_accu;
 	double	m_alpha;
+	int		m_foregroundCount;
 	bool	m_isInitialized;
+	BackgroundModel m_model;
+	SegmentStats m_stats; // cells and zones
 	double	m_threshold;
 };
 
@@ -1,6 +1,7 @@
 #ifndef CIRCULARBUFFER_H
 #define CIRCULARBUFFER_H
 
+#include <cstddef> // size_t
 #include <vector>
 
 
@@ -73,6 +74,21 @@ public:
         m_full = m_tail == m_head ? true : false;
     }
 
+    // push to tail in place: returns slot of new tail element (oldest element, if full)
+    // its buffers can be overwritten without allocation, e.g. cv::Mat::copyTo of same size
+    T& pushInPlace()
+    {
+        T& item = m_buffer[m_tail];
+        incTail();
+
+        if (m_full) {
+            incHead();
+        }
+
+        m_full = m_tail == m_head ? true : false;
+        return item;
+    }
+
     void reset()
     {
         m_head = m_tail = 0;
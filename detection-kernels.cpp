@@ -0,0 +1,1307 @@
+#include "detection-kernels.h"
+#include "workerpool.h"
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    #include <immintrin.h>
+    #define AVX2_KERNEL
+#endif
+#if defined(__ARM_NEON)
+    #include <arm_neon.h>
+#endif
+
+#include <algorithm> // fill
+#include <array>
+#include <cstdint>
+#include <cstdlib> // abs
+#include <vector>
+
+/* opencv reference of low pass segmentation (MotionDetector before fusion):
+ * accumulateWeighted(image, accu, alpha)       accu 32F, 1 pass
+ * convertScaleAbs(accu, accu8U)                round to nearest, 1 pass
+ * absdiff(image, accu8U, mask)                 1 pass
+ * threshold(mask, mask, thresh, 255, BINARY)   compare with cvFloor(thresh), 1 pass
+ * countNonZero(mask)                           1 pass
+ *
+ * bit compatibility requires the same float operations as opencv:
+ * vector body:  accu * (float)(1.0 - alpha) + image * alpha, fused multiply add on avx2 / aarch64
+ * scalar tail:  image * alpha + accu * (1 - alpha) with single precision beta (accW_general_)
+ * continuous frames are processed as one row, so that the scalar tail matches as well */
+
+
+// 8 bit threshold compares with integer part, as cv::threshold
+static int segmentThreshold(double threshold, SimdPath& path)
+{
+    int iThreshold = cvFloor(threshold);
+    iThreshold = iThreshold < -1 ? -1 : iThreshold;
+    iThreshold = iThreshold > UCHAR_MAX ? UCHAR_MAX : iThreshold;
+    // all or no pixels foreground: not representable by unsigned 8 bit compare
+    if (iThreshold < 0 || iThreshold == UCHAR_MAX)
+        path = SimdPath::scalar;
+    path = resolveSimdPath(path);
+    return iThreshold;
+}
+
+
+// scalar fallback and tail of vector paths
+static int lowPassRowScalar(const uchar* src, float* accu, uchar* mask, int x, int len,
+                            double alpha, int threshold, const uchar* thresholds)
+{
+    float a = static_cast<float>(alpha);
+    float b = 1 - a;
+    int count = 0;
+    for (; x < len; ++x) {
+        accu[x] = src[x] * a + accu[x] * b;
+        int diff = std::abs(src[x] - cv::saturate_cast<uchar>(accu[x]));
+        int th = thresholds ? thresholds[x] : threshold;
+        mask[x] = diff > th ? UCHAR_MAX : 0;
+        count += diff > th ? 1 : 0;
+    }
+    return count;
+}
+
+
+#if defined(__SSE2__)
+// 16 pixels per step, multiply and add (opencv baseline up to sse4.1)
+static int lowPassRowSse2(const uchar* src, float* accu, uchar* mask, int len,
+                          double alpha, int threshold, const uchar* thresholds)
+{
+    const __m128 vAlpha = _mm_set1_ps(static_cast<float>(alpha));
+    const __m128 vBeta = _mm_set1_ps(static_cast<float>(1.0 - alpha));
+    const __m128i vThreshold = _mm_set1_epi8(static_cast<char>(threshold));
+    const __m128i vZero = _mm_setzero_si128();
+    const __m128i vOnes = _mm_set1_epi8(-1);
+    int count = 0;
+    int x = 0;
+    for (; x <= len - 16; x += 16) {
+        __m128i src8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        __m128i src16lo = _mm_unpacklo_epi8(src8, vZero);
+        __m128i src16hi = _mm_unpackhi_epi8(src8, vZero);
+        __m128i src32[4] = {_mm_unpacklo_epi16(src16lo, vZero), _mm_unpackhi_epi16(src16lo, vZero),
+                            _mm_unpacklo_epi16(src16hi, vZero), _mm_unpackhi_epi16(src16hi, vZero)};
+        __m128i bg32[4];
+        for (int k = 0; k < 4; ++k) {
+            __m128 acc = _mm_loadu_ps(accu + x + 4 * k);
+            acc = _mm_add_ps(_mm_mul_ps(acc, vBeta), _mm_mul_ps(_mm_cvtepi32_ps(src32[k]), vAlpha));
+            _mm_storeu_ps(accu + x + 4 * k, acc);
+            bg32[k] = _mm_cvtps_epi32(acc); // round to nearest even
+        }
+        __m128i bg8 = _mm_packus_epi16(_mm_packs_epi32(bg32[0], bg32[1]),
+                                       _mm_packs_epi32(bg32[2], bg32[3]));
+
+        // |src - bg| > threshold  <=>  saturated (|src - bg| - threshold) != 0
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(src8, bg8), _mm_subs_epu8(bg8, src8));
+        __m128i th = thresholds ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(thresholds + x)) : vThreshold;
+        __m128i fg = _mm_xor_si128(_mm_cmpeq_epi8(_mm_subs_epu8(diff, th), vZero), vOnes);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mask + x), fg);
+        count += __builtin_popcount(static_cast<unsigned>(_mm_movemask_epi8(fg)));
+    }
+    return count + lowPassRowScalar(src, accu, mask, x, len, alpha, threshold, thresholds);
+}
+#endif
+
+
+#if defined(AVX2_KERNEL)
+// 32 pixels per step, fused multiply add (opencv avx2 dispatch implies fma3)
+__attribute__((target("avx2,fma")))
+static int lowPassRowAvx2(const uchar* src, float* accu, uchar* mask, int len,
+                          double alpha, int threshold, const uchar* thresholds)
+{
+    const __m256 vAlpha = _mm256_set1_ps(static_cast<float>(alpha));
+    const __m256 vBeta = _mm256_set1_ps(static_cast<float>(1.0 - alpha));
+    const __m256i vThreshold = _mm256_set1_epi8(static_cast<char>(threshold));
+    const __m256i vZero = _mm256_setzero_si256();
+    const __m256i vOnes = _mm256_set1_epi8(-1);
+    int count = 0;
+    int x = 0;
+    for (; x <= len - 32; x += 32) {
+        __m128i bg8[2];
+        for (int half = 0; half < 2; ++half) {
+            __m256i bg32[2];
+            for (int k = 0; k < 2; ++k) {
+                int offset = x + 16 * half + 8 * k;
+                __m256i src32 = _mm256_cvtepu8_epi32(
+                            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + offset)));
+                __m256 acc = _mm256_loadu_ps(accu + offset);
+                acc = _mm256_fmadd_ps(acc, vBeta, _mm256_mul_ps(_mm256_cvtepi32_ps(src32), vAlpha));
+                _mm256_storeu_ps(accu + offset, acc);
+                bg32[k] = _mm256_cvtps_epi32(acc);
+            }
+            // pack works within 128 bit lanes: restore pixel order
+            __m256i bg16 = _mm256_permute4x64_epi64(_mm256_packs_epi32(bg32[0], bg32[1]), 0xD8);
+            bg8[half] = _mm_packus_epi16(_mm256_castsi256_si128(bg16),
+                                         _mm256_extracti128_si256(bg16, 1));
+        }
+        __m256i src8 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+        __m256i bg = _mm256_inserti128_si256(_mm256_castsi128_si256(bg8[0]), bg8[1], 1);
+
+        __m256i diff = _mm256_or_si256(_mm256_subs_epu8(src8, bg), _mm256_subs_epu8(bg, src8));
+        __m256i th = thresholds ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(thresholds + x)) : vThreshold;
+        __m256i fg = _mm256_xor_si256(_mm256_cmpeq_epi8(_mm256_subs_epu8(diff, th), vZero), vOnes);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(mask + x), fg);
+        count += __builtin_popcount(static_cast<unsigned>(_mm256_movemask_epi8(fg)));
+    }
+    return count + lowPassRowScalar(src, accu, mask, x, len, alpha, threshold, thresholds);
+}
+#endif
+
+
+#if defined(__ARM_NEON)
+// 16 pixels per step
+// aarch64: fused multiply add, round to nearest even
+// armv7:   multiply accumulate, round half away from zero (opencv v_round)
+static int lowPassRowNeon(const uchar* src, float* accu, uchar* mask, int len,
+                          double alpha, int threshold, const uchar* thresholds)
+{
+    const float32x4_t vAlpha = vdupq_n_f32(static_cast<float>(alpha));
+    const float32x4_t vBeta = vdupq_n_f32(static_cast<float>(1.0 - alpha));
+    const uint8x16_t vThreshold = vdupq_n_u8(static_cast<uint8_t>(threshold));
+#if !defined(__aarch64__)
+    const float32x4_t vHalf = vdupq_n_f32(0.5f);
+#endif
+    uint32x4_t vCount = vdupq_n_u32(0);
+    int x = 0;
+    for (; x <= len - 16; x += 16) {
+        uint8x16_t src8 = vld1q_u8(src + x);
+        uint16x8_t src16lo = vmovl_u8(vget_low_u8(src8));
+        uint16x8_t src16hi = vmovl_u8(vget_high_u8(src8));
+        uint32x4_t src32[4] = {vmovl_u16(vget_low_u16(src16lo)), vmovl_u16(vget_high_u16(src16lo)),
+                               vmovl_u16(vget_low_u16(src16hi)), vmovl_u16(vget_high_u16(src16hi))};
+        int32x4_t bg32[4];
+        for (int k = 0; k < 4; ++k) {
+            float32x4_t acc = vld1q_f32(accu + x + 4 * k);
+            float32x4_t srcAlpha = vmulq_f32(vcvtq_f32_u32(src32[k]), vAlpha);
+#if defined(__aarch64__)
+            acc = vfmaq_f32(srcAlpha, acc, vBeta);
+            bg32[k] = vcvtnq_s32_f32(acc);
+#else
+            acc = vmlaq_f32(srcAlpha, acc, vBeta);
+            bg32[k] = vcvtq_s32_f32(vaddq_f32(acc, vHalf)); // accu >= 0
+#endif
+            vst1q_f32(accu + x + 4 * k, acc);
+        }
+        uint8x16_t bg8 = vcombine_u8(
+                    vqmovun_s16(vcombine_s16(vqmovn_s32(bg32[0]), vqmovn_s32(bg32[1]))),
+                    vqmovun_s16(vcombine_s16(vqmovn_s32(bg32[2]), vqmovn_s32(bg32[3]))));
+
+        uint8x16_t th = thresholds ? vld1q_u8(thresholds + x) : vThreshold;
+        uint8x16_t fg = vcgtq_u8(vabdq_u8(src8, bg8), th);
+        vst1q_u8(mask + x, fg);
+        vCount = vpadalq_u16(vCount, vpaddlq_u8(vshrq_n_u8(fg, 7)));
+    }
+    uint64x2_t vCount64 = vpaddlq_u32(vCount);
+    int count = static_cast<int>(vgetq_lane_u64(vCount64, 0) + vgetq_lane_u64(vCount64, 1));
+    return count + lowPassRowScalar(src, accu, mask, x, len, alpha, threshold, thresholds);
+}
+#endif
+
+
+/* Q8.8 fixed point model: unsigned differences keep all lanes in 16 bit
+ * accu += (src << 8 - accu) >> shift   if src << 8 >= accu
+ * accu -= (accu - src << 8) >> shift   else
+ * bg = (accu + 128) >> 8 */
+static int lowPassRowQ8Scalar(const uchar* src, ushort* accu, uchar* mask, int x, int len,
+                              int shift, int threshold, const uchar* thresholds)
+{
+    int count = 0;
+    for (; x < len; ++x) {
+        int srcQ = src[x] << 8;
+        int acc = accu[x];
+        acc += srcQ >= acc ? (srcQ - acc) >> shift : -((acc - srcQ) >> shift);
+        accu[x] = static_cast<ushort>(acc);
+        int diff = std::abs(src[x] - ((acc + 128) >> 8));
+        int th = thresholds ? thresholds[x] : threshold;
+        mask[x] = diff > th ? UCHAR_MAX : 0;
+        count += diff > th ? 1 : 0;
+    }
+    return count;
+}
+
+
+#if defined(__SSE2__)
+// 16 pixels per step, 8 lanes of 16 bit (4 lanes of float)
+static int lowPassRowQ8Sse2(const uchar* src, ushort* accu, uchar* mask, int len,
+                            int shift, int threshold, const uchar* thresholds)
+{
+    const __m128i vShift = _mm_cvtsi32_si128(shift);
+    const __m128i vRound = _mm_set1_epi16(128);
+    const __m128i vThreshold = _mm_set1_epi8(static_cast<char>(threshold));
+    const __m128i vZero = _mm_setzero_si128();
+    const __m128i vOnes = _mm_set1_epi8(-1);
+    int count = 0;
+    int x = 0;
+    for (; x <= len - 16; x += 16) {
+        __m128i src8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        // src in high byte: src << 8
+        __m128i srcQ[2] = {_mm_unpacklo_epi8(vZero, src8), _mm_unpackhi_epi8(vZero, src8)};
+        __m128i bg16[2];
+        for (int k = 0; k < 2; ++k) {
+            __m128i acc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(accu + x + 8 * k));
+            __m128i up = _mm_srl_epi16(_mm_subs_epu16(srcQ[k], acc), vShift);
+            __m128i down = _mm_srl_epi16(_mm_subs_epu16(acc, srcQ[k]), vShift);
+            acc = _mm_sub_epi16(_mm_add_epi16(acc, up), down);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(accu + x + 8 * k), acc);
+            bg16[k] = _mm_srli_epi16(_mm_adds_epu16(acc, vRound), 8);
+        }
+        __m128i bg8 = _mm_packus_epi16(bg16[0], bg16[1]);
+
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(src8, bg8), _mm_subs_epu8(bg8, src8));
+        __m128i th = thresholds ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(thresholds + x)) : vThreshold;
+        __m128i fg = _mm_xor_si128(_mm_cmpeq_epi8(_mm_subs_epu8(diff, th), vZero), vOnes);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mask + x), fg);
+        count += __builtin_popcount(static_cast<unsigned>(_mm_movemask_epi8(fg)));
+    }
+    return count + lowPassRowQ8Scalar(src, accu, mask, x, len, shift, threshold, thresholds);
+}
+#endif
+
+
+#if defined(AVX2_KERNEL)
+// 32 pixels per step, 16 lanes of 16 bit
+__attribute__((target("avx2")))
+static int lowPassRowQ8Avx2(const uchar* src, ushort* accu, uchar* mask, int len,
+                            int shift, int threshold, const uchar* thresholds)
+{
+    const __m128i vShift = _mm_cvtsi32_si128(shift);
+    const __m256i vRound = _mm256_set1_epi16(128);
+    const __m256i vThreshold = _mm256_set1_epi8(static_cast<char>(threshold));
+    const __m256i vZero = _mm256_setzero_si256();
+    const __m256i vOnes = _mm256_set1_epi8(-1);
+    int count = 0;
+    int x = 0;
+    for (; x <= len - 32; x += 32) {
+        __m256i bg16[2];
+        for (int k = 0; k < 2; ++k) {
+            __m256i srcQ = _mm256_slli_epi16(_mm256_cvtepu8_epi16(
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x + 16 * k))), 8);
+            __m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(accu + x + 16 * k));
+            __m256i up = _mm256_srl_epi16(_mm256_subs_epu16(srcQ, acc), vShift);
+            __m256i down = _mm256_srl_epi16(_mm256_subs_epu16(acc, srcQ), vShift);
+            acc = _mm256_sub_epi16(_mm256_add_epi16(acc, up), down);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(accu + x + 16 * k), acc);
+            bg16[k] = _mm256_srli_epi16(_mm256_adds_epu16(acc, vRound), 8);
+        }
+        // pack works within 128 bit lanes: restore pixel order
+        __m256i bg = _mm256_permute4x64_epi64(_mm256_packus_epi16(bg16[0], bg16[1]), 0xD8);
+        __m256i src8 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+
+        __m256i diff = _mm256_or_si256(_mm256_subs_epu8(src8, bg), _mm256_subs_epu8(bg, src8));
+        __m256i th = thresholds ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(thresholds + x)) : vThreshold;
+        __m256i fg = _mm256_xor_si256(_mm256_cmpeq_epi8(_mm256_subs_epu8(diff, th), vZero), vOnes);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(mask + x), fg);
+        count += __builtin_popcount(static_cast<unsigned>(_mm256_movemask_epi8(fg)));
+    }
+    return count + lowPassRowQ8Scalar(src, accu, mask, x, len, shift, threshold, thresholds);
+}
+#endif
+
+
+#if defined(__ARM_NEON)
+// 16 pixels per step, 8 lanes of 16 bit
+static int lowPassRowQ8Neon(const uchar* src, ushort* accu, uchar* mask, int len,
+                            int shift, int threshold, const uchar* thresholds)
+{
+    const int16x8_t vShift = vdupq_n_s16(static_cast<int16_t>(-shift)); // negative: shift right
+    const uint8x16_t vThreshold = vdupq_n_u8(static_cast<uint8_t>(threshold));
+    uint32x4_t vCount = vdupq_n_u32(0);
+    int x = 0;
+    for (; x <= len - 16; x += 16) {
+        uint8x16_t src8 = vld1q_u8(src + x);
+        uint16x8_t srcQ[2] = {vshll_n_u8(vget_low_u8(src8), 8), vshll_n_u8(vget_high_u8(src8), 8)};
+        uint8x8_t bg8[2];
+        for (int k = 0; k < 2; ++k) {
+            uint16x8_t acc = vld1q_u16(accu + x + 8 * k);
+            uint16x8_t up = vshlq_u16(vqsubq_u16(srcQ[k], acc), vShift);
+            uint16x8_t down = vshlq_u16(vqsubq_u16(acc, srcQ[k]), vShift);
+            acc = vsubq_u16(vaddq_u16(acc, up), down);
+            vst1q_u16(accu + x + 8 * k, acc);
+            bg8[k] = vrshrn_n_u16(acc, 8); // (acc + 128) >> 8
+        }
+        uint8x16_t th = thresholds ? vld1q_u8(thresholds + x) : vThreshold;
+        uint8x16_t fg = vcgtq_u8(vabdq_u8(src8, vcombine_u8(bg8[0], bg8[1])), th);
+        vst1q_u8(mask + x, fg);
+        vCount = vpadalq_u16(vCount, vpaddlq_u8(vshrq_n_u8(fg, 7)));
+    }
+    uint64x2_t vCount64 = vpaddlq_u32(vCount);
+    int count = static_cast<int>(vgetq_lane_u64(vCount64, 0) + vgetq_lane_u64(vCount64, 1));
+    return count + lowPassRowQ8Scalar(src, accu, mask, x, len, shift, threshold, thresholds);
+}
+#endif
+
+
+// frame differencing: previous frame is background, replaced by current frame
+static int frameDiffRowScalar(const uchar* src, uchar* prev, uchar* mask, int x, int len,
+                              int threshold, const uchar* thresholds)
+{
+    int count = 0;
+    for (; x < len; ++x) {
+        int diff = std::abs(src[x] - prev[x]);
+        prev[x] = src[x];
+        int th = thresholds ? thresholds[x] : threshold;
+        mask[x] = diff > th ? UCHAR_MAX : 0;
+        count += diff > th ? 1 : 0;
+    }
+    return count;
+}
+
+
+#if defined(__SSE2__)
+static int frameDiffRowSse2(const uchar* src, uchar* prev, uchar* mask, int len,
+                            int threshold, const uchar* thresholds)
+{
+    const __m128i vThreshold = _mm_set1_epi8(static_cast<char>(threshold));
+    const __m128i vZero = _mm_setzero_si128();
+    const __m128i vOnes = _mm_set1_epi8(-1);
+    int count = 0;
+    int x = 0;
+    for (; x <= len - 16; x += 16) {
+        __m128i src8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        __m128i prev8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + x));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(prev + x), src8);
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(src8, prev8), _mm_subs_epu8(prev8, src8));
+        __m128i th = thresholds ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(thresholds + x)) : vThreshold;
+        __m128i fg = _mm_xor_si128(_mm_cmpeq_epi8(_mm_subs_epu8(diff, th), vZero), vOnes);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mask + x), fg);
+        count += __builtin_popcount(static_cast<unsigned>(_mm_movemask_epi8(fg)));
+    }
+    return count + frameDiffRowScalar(src, prev, mask, x, len, threshold, thresholds);
+}
+#endif
+
+
+#if defined(AVX2_KERNEL)
+__attribute__((target("avx2")))
+static int frameDiffRowAvx2(const uchar* src, uchar* prev, uchar* mask, int len,
+                            int threshold, const uchar* thresholds)
+{
+    const __m256i vThreshold = _mm256_set1_epi8(static_cast<char>(threshold));
+    const __m256i vZero = _mm256_setzero_si256();
+    const __m256i vOnes = _mm256_set1_epi8(-1);
+    int count = 0;
+    int x = 0;
+    for (; x <= len - 32; x += 32) {
+        __m256i src8 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+        __m256i prev8 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev + x));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(prev + x), src8);
+        __m256i diff = _mm256_or_si256(_mm256_subs_epu8(src8, prev8), _mm256_subs_epu8(prev8, src8));
+        __m256i th = thresholds ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(thresholds + x)) : vThreshold;
+        __m256i fg = _mm256_xor_si256(_mm256_cmpeq_epi8(_mm256_subs_epu8(diff, th), vZero), vOnes);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(mask + x), fg);
+        count += __builtin_popcount(static_cast<unsigned>(_mm256_movemask_epi8(fg)));
+    }
+    return count + frameDiffRowScalar(src, prev, mask, x, len, threshold, thresholds);
+}
+#endif
+
+
+#if defined(__ARM_NEON)
+static int frameDiffRowNeon(const uchar* src, uchar* prev, uchar* mask, int len,
+                            int threshold, const uchar* thresholds)
+{
+    const uint8x16_t vThreshold = vdupq_n_u8(static_cast<uint8_t>(threshold));
+    uint32x4_t vCount = vdupq_n_u32(0);
+    int x = 0;
+    for (; x <= len - 16; x += 16) {
+        uint8x16_t src8 = vld1q_u8(src + x);
+        uint8x16_t prev8 = vld1q_u8(prev + x);
+        vst1q_u8(prev + x, src8);
+        uint8x16_t th = thresholds ? vld1q_u8(thresholds + x) : vThreshold;
+        uint8x16_t fg = vcgtq_u8(vabdq_u8(src8, prev8), th);
+        vst1q_u8(mask + x, fg);
+        vCount = vpadalq_u16(vCount, vpaddlq_u8(vshrq_n_u8(fg, 7)));
+    }
+    uint64x2_t vCount64 = vpaddlq_u32(vCount);
+    int count = static_cast<int>(vgetq_lane_u64(vCount64, 0) + vgetq_lane_u64(vCount64, 1));
+    return count + frameDiffRowScalar(src, prev, mask, x, len, threshold, thresholds);
+}
+#endif
+
+
+// rounded mean by multiplication with reciprocal: exact for n < 2^32 / d
+static constexpr uint64_t reciprocal(int d)
+{
+    return ((uint64_t(1) << 32) + static_cast<uint64_t>(d) - 1) / static_cast<uint64_t>(d);
+}
+
+
+// mean of area pixels, rounded as resize INTER_AREA at integer factors:
+// half up at factor 2 (integer path of opencv), else half to even (cvRound of sum / area)
+// ties detected exactly, as sum + area / 2 is a multiple of area
+static constexpr uchar poolMean(uint32_t sum, int area, uint64_t scale, bool isHalfEven)
+{
+    const uint32_t half = static_cast<uint32_t>(area / 2);
+    uint32_t mean = static_cast<uint32_t>(((sum + half) * scale) >> 32);
+    if (isHalfEven && mean * static_cast<uint32_t>(area) == sum + half)
+        mean &= ~1u;
+    return static_cast<uchar>(mean);
+}
+
+
+static inline int reflect101(int v, int len)
+{
+    if (len == 1)
+        return 0;
+    while (v < 0 || v >= len)
+        v = v < 0 ? -v : 2 * len - 2 - v;
+    return v;
+}
+
+
+// vertical part of area downscale: add source row to 16 bit column sums
+static void poolRowAddScalar(const uchar* src, ushort* sum, int x, int len)
+{
+    for (; x < len; ++x)
+        sum[x] = static_cast<ushort>(sum[x] + src[x]);
+}
+
+
+#if defined(__SSE2__)
+static void poolRowAddSse2(const uchar* src, ushort* sum, int len)
+{
+    const __m128i vZero = _mm_setzero_si128();
+    int x = 0;
+    for (; x <= len - 16; x += 16) {
+        __m128i src8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        __m128i* dst = reinterpret_cast<__m128i*>(sum + x);
+        _mm_storeu_si128(dst, _mm_add_epi16(_mm_loadu_si128(dst), _mm_unpacklo_epi8(src8, vZero)));
+        _mm_storeu_si128(dst + 1, _mm_add_epi16(_mm_loadu_si128(dst + 1), _mm_unpackhi_epi8(src8, vZero)));
+    }
+    poolRowAddScalar(src, sum, x, len);
+}
+#endif
+
+
+#if defined(AVX2_KERNEL)
+__attribute__((target("avx2")))
+static void poolRowAddAvx2(const uchar* src, ushort* sum, int len)
+{
+    int x = 0;
+    for (; x <= len - 32; x += 32) {
+        for (int k = 0; k < 2; ++k) {
+            __m256i src16 = _mm256_cvtepu8_epi16(
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x + 16 * k)));
+            __m256i* dst = reinterpret_cast<__m256i*>(sum + x + 16 * k);
+            _mm256_storeu_si256(dst, _mm256_add_epi16(_mm256_loadu_si256(dst), src16));
+        }
+    }
+    poolRowAddScalar(src, sum, x, len);
+}
+#endif
+
+
+#if defined(__ARM_NEON)
+static void poolRowAddNeon(const uchar* src, ushort* sum, int len)
+{
+    int x = 0;
+    for (; x <= len - 16; x += 16) {
+        uint8x16_t src8 = vld1q_u8(src + x);
+        vst1q_u16(sum + x, vaddw_u8(vld1q_u16(sum + x), vget_low_u8(src8)));
+        vst1q_u16(sum + x + 8, vaddw_u8(vld1q_u16(sum + x + 8), vget_high_u8(src8)));
+    }
+    poolRowAddScalar(src, sum, x, len);
+}
+#endif
+
+
+static void poolRowAdd(const uchar* src, ushort* sum, int len, SimdPath path)
+{
+    switch (path) {
+#if defined(AVX2_KERNEL)
+    case SimdPath::avx2:
+        poolRowAddAvx2(src, sum, len);
+        break;
+#endif
+#if defined(__SSE2__)
+    case SimdPath::sse2:
+        poolRowAddSse2(src, sum, len);
+        break;
+#endif
+#if defined(__ARM_NEON)
+    case SimdPath::neon:
+        poolRowAddNeon(src, sum, len);
+        break;
+#endif
+    default:
+        poolRowAddScalar(src, sum, 0, len);
+        break;
+    }
+}
+
+
+// 64 bit words of packed mask row
+static inline int packedWords(int width)
+{
+    return (width + 63) / 64;
+}
+
+
+// bits begin ... end - 1 of packed row
+static inline int popcountBits(const uint64_t* words, int begin, int end)
+{
+    int count = 0;
+    while (begin < end) {
+        int bit = begin % 64;
+        int n = std::min(64 - bit, end - begin);
+        uint64_t word = words[begin / 64] >> bit;
+        if (n < 64)
+            word &= (uint64_t(1) << n) - 1;
+        count += __builtin_popcountll(word);
+        begin += n;
+    }
+    return count;
+}
+
+
+// 8 pixels -> 1 byte, pixel x -> bit x
+static void packRowScalar(const uchar* src, uchar* dst, int x, int len)
+{
+    for (; x < len; x += 8) {
+        int end = std::min(x + 8, len);
+        uchar bits = 0;
+        for (int k = x; k < end; ++k)
+            bits = static_cast<uchar>(bits | ((src[k] >> 7) << (k - x)));
+        dst[x / 8] = bits;
+    }
+}
+
+
+#if defined(__SSE2__)
+// msb of 16 bytes -> 16 bits
+static void packRowSse2(const uchar* src, uchar* dst, int len)
+{
+    int x = 0;
+    for (; x <= len - 16; x += 16) {
+        int bits = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x)));
+        dst[x / 8] = static_cast<uchar>(bits);
+        dst[x / 8 + 1] = static_cast<uchar>(bits >> 8);
+    }
+    packRowScalar(src, dst, x, len);
+}
+#endif
+
+
+#if defined(AVX2_KERNEL)
+__attribute__((target("avx2")))
+static void packRowAvx2(const uchar* src, uchar* dst, int len)
+{
+    int x = 0;
+    for (; x <= len - 32; x += 32) {
+        uint32_t bits = static_cast<uint32_t>(
+                    _mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x))));
+        for (int k = 0; k < 4; ++k)
+            dst[x / 8 + k] = static_cast<uchar>(bits >> (8 * k));
+    }
+    packRowScalar(src, dst, x, len);
+}
+#endif
+
+
+#if defined(__ARM_NEON)
+// no movemask: weight msb of each byte by its bit, add pairwise within 8 byte halves
+static void packRowNeon(const uchar* src, uchar* dst, int len)
+{
+    static const uchar weights[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    const uint8x16_t vWeights = vld1q_u8(weights);
+    int x = 0;
+    for (; x <= len - 16; x += 16) {
+        uint8x16_t msb = vshrq_n_u8(vld1q_u8(src + x), 7);
+        uint8x16_t bits = vmulq_u8(msb, vWeights);
+        uint64x2_t sums = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(bits)));
+        dst[x / 8] = static_cast<uchar>(vgetq_lane_u64(sums, 0));
+        dst[x / 8 + 1] = static_cast<uchar>(vgetq_lane_u64(sums, 1));
+    }
+    packRowScalar(src, dst, x, len);
+}
+#endif
+
+
+bool isSimdPathSupported(SimdPath path)
+{
+    switch (path) {
+    case SimdPath::best:
+    case SimdPath::scalar:
+        return true;
+    case SimdPath::sse2:
+#if defined(__SSE2__)
+        return true;
+#else
+        return false;
+#endif
+    case SimdPath::avx2:
+#if defined(AVX2_KERNEL)
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+        return false;
+#endif
+    case SimdPath::neon:
+#if defined(__ARM_NEON)
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+
+// foreground pixels of mask rows y ... y + rows - 1 added to cell counts of band
+static void countCells(const cv::Mat& mask, int y, int rows, int cellSize, int* cellCounts)
+{
+    for (int row = y; row < y + rows; ++row) {
+        const uchar* fg = mask.ptr<uchar>(row);
+        for (int cell = 0, x = 0; x < mask.cols; ++cell) {
+            int end = std::min(x + cellSize, mask.cols);
+            int count = 0;
+            for (; x < end; ++x)
+                count += fg[x] & 1;
+            cellCounts[cell] += count;
+        }
+    }
+}
+
+
+// foreground pixels of mask rows y ... y + rows - 1 added to count of their label
+static void countZones(const cv::Mat& mask, const cv::Mat& labels, int y, int rows, int* zoneCounts)
+{
+    for (int row = y; row < y + rows; ++row) {
+        const uchar* fg = mask.ptr<uchar>(row);
+        const uchar* label = labels.ptr<uchar>(row);
+        for (int x = 0; x < mask.cols; ++x)
+            zoneCounts[label[x]] += fg[x] & 1;
+    }
+}
+
+
+/* frame in bands of cellSize rows (whole frame w/o cells)
+ * continuous band as one row, as opencv does: if band size is a multiple of the vector width
+ * (16 rows of even width), vector body and scalar tail split as for the whole frame
+ * band with skipped cells: runs of segmented cells row by row, mask of skipped cells cleared
+ * segmentRow(row, x, len, thresholds): segments len pixels starting at row, x,
+ * returns foreground count */
+template <typename SegmentRow>
+static int segmentBands(const cv::Mat& image, const cv::Mat& accu, cv::Mat& mask,
+                        SegmentStats* stats, SegmentRow segmentRow)
+{
+    bool hasThresholds = stats && !stats->thresholds.empty();
+    bool hasLabels = stats && !stats->labels.empty();
+    bool hasCells = stats && stats->cellSize > 0;
+    bool hasSkip = hasCells && !stats->skipCells.empty();
+    bool isContinuous = image.isContinuous() && accu.isContinuous() && mask.isContinuous();
+    int bandRows = image.rows;
+
+    if (hasThresholds) {
+        CV_Assert(stats->thresholds.type() == CV_8UC1 && stats->thresholds.size() == image.size());
+        isContinuous = isContinuous && stats->thresholds.isContinuous();
+    }
+    if (hasLabels) {
+        CV_Assert(stats->labels.type() == CV_8UC1 && stats->labels.size() == image.size());
+        stats->zoneCounts.assign(UCHAR_MAX + 1, 0);
+    }
+    if (hasCells) {
+        int cellSize = stats->cellSize;
+        bandRows = cellSize;
+        stats->cells.create((image.rows + cellSize - 1) / cellSize, (image.cols + cellSize - 1) / cellSize, CV_32S);
+        stats->cells.setTo(cv::Scalar(0));
+        if (hasSkip)
+            CV_Assert(stats->skipCells.type() == CV_8UC1 && stats->skipCells.size() == stats->cells.size());
+    }
+
+    int count = 0;
+    for (int y = 0; y < image.rows; y += bandRows) {
+        int rows = std::min(bandRows, image.rows - y);
+        const uchar* skip = hasSkip ? stats->skipCells.ptr<uchar>(y / stats->cellSize) : nullptr;
+        if (skip && std::any_of(skip, skip + stats->skipCells.cols, [](uchar cell) { return cell != 0; })) {
+            const int cellSize = stats->cellSize;
+            for (int row = y; row < y + rows; ++row) {
+                const uchar* thresholds = hasThresholds ? stats->thresholds.ptr<uchar>(row) : nullptr;
+                uchar* fg = mask.ptr<uchar>(row);
+                for (int cell = 0; cell < stats->skipCells.cols;) {
+                    bool isSkipped = skip[cell] != 0;
+                    int x = cell * cellSize;
+                    while (cell < stats->skipCells.cols && (skip[cell] != 0) == isSkipped)
+                        ++cell;
+                    int end = std::min(cell * cellSize, image.cols);
+                    if (isSkipped)
+                        std::fill(fg + x, fg + end, 0);
+                    else
+                        count += segmentRow(row, x, end - x, thresholds ? thresholds + x : nullptr);
+                }
+            }
+        } else if (isContinuous) {
+            count += segmentRow(y, 0, rows * image.cols, hasThresholds ? stats->thresholds.ptr<uchar>(y) : nullptr);
+        } else {
+            for (int row = y; row < y + rows; ++row)
+                count += segmentRow(row, 0, image.cols, hasThresholds ? stats->thresholds.ptr<uchar>(row) : nullptr);
+        }
+        if (hasCells)
+            countCells(mask, y, rows, stats->cellSize, stats->cells.ptr<int>(y / stats->cellSize));
+        if (hasLabels)
+            countZones(mask, stats->labels, y, rows, stats->zoneCounts.data());
+    }
+    return count;
+}
+
+
+static int frameDiffSegment(const cv::Mat& image, cv::Mat& previous, cv::Mat& mask,
+                            double threshold, SegmentStats* stats, SimdPath path)
+{
+    CV_Assert(image.type() == CV_8UC1 && previous.type() == CV_8UC1);
+    CV_Assert(image.rows == previous.rows && image.cols == previous.cols);
+    mask.create(image.rows, image.cols, CV_8UC1);
+    int iThreshold = stats && !stats->thresholds.empty()
+            ? segmentThreshold(0, path) : segmentThreshold(threshold, path);
+
+    return segmentBands(image, previous, mask, stats, [&](int row, int x, int len, const uchar* thresholds) {
+        const uchar* src = image.ptr<uchar>(row) + x;
+        uchar* prev = previous.ptr<uchar>(row) + x;
+        uchar* fg = mask.ptr<uchar>(row) + x;
+        switch (path) {
+#if defined(AVX2_KERNEL)
+        case SimdPath::avx2:
+            return frameDiffRowAvx2(src, prev, fg, len, iThreshold, thresholds);
+#endif
+#if defined(__SSE2__)
+        case SimdPath::sse2:
+            return frameDiffRowSse2(src, prev, fg, len, iThreshold, thresholds);
+#endif
+#if defined(__ARM_NEON)
+        case SimdPath::neon:
+            return frameDiffRowNeon(src, prev, fg, len, iThreshold, thresholds);
+#endif
+        default:
+            return frameDiffRowScalar(src, prev, fg, 0, len, iThreshold, thresholds);
+        }
+    });
+}
+
+
+int frameDiffSegment(const cv::Mat& image, cv::Mat& previous, cv::Mat& mask,
+                     double threshold, SimdPath path)
+{
+    return frameDiffSegment(image, previous, mask, threshold, nullptr, path);
+}
+
+
+int frameDiffSegment(const cv::Mat& image, cv::Mat& previous, cv::Mat& mask,
+                     double threshold, SegmentStats& stats, SimdPath path)
+{
+    return frameDiffSegment(image, previous, mask, threshold, &stats, path);
+}
+
+
+void countPackedCells(const cv::Mat& packed, int width, int cellSize, cv::Mat& cells)
+{
+    CV_Assert(packed.type() == CV_8UC1 && packed.cols == packedWords(width) * 8 && cellSize > 0);
+    cells.create((packed.rows + cellSize - 1) / cellSize, (width + cellSize - 1) / cellSize, CV_32S);
+    cells.setTo(cv::Scalar(0));
+    for (int row = 0; row < packed.rows; ++row) {
+        const uint64_t* words = packed.ptr<uint64_t>(row);
+        int* count = cells.ptr<int>(row / cellSize);
+        for (int cell = 0; cell < cells.cols; ++cell)
+            count[cell] += popcountBits(words, cell * cellSize, std::min((cell + 1) * cellSize, width));
+    }
+}
+
+
+static int lowPassSegment(const cv::Mat& image, cv::Mat& accu, cv::Mat& mask,
+                          double alpha, double threshold, SegmentStats* stats, SimdPath path)
+{
+    CV_Assert(image.type() == CV_8UC1 && accu.type() == CV_32F);
+    CV_Assert(image.rows == accu.rows && image.cols == accu.cols);
+    mask.create(image.rows, image.cols, CV_8UC1);
+
+    // threshold map: 0 ... 255 representable by all paths
+    int iThreshold = stats && !stats->thresholds.empty()
+            ? segmentThreshold(0, path) : segmentThreshold(threshold, path);
+
+    return segmentBands(image, accu, mask, stats, [&](int row, int x, int len, const uchar* thresholds) {
+        const uchar* src = image.ptr<uchar>(row) + x;
+        float* acc = accu.ptr<float>(row) + x;
+        uchar* fg = mask.ptr<uchar>(row) + x;
+        switch (path) {
+#if defined(AVX2_KERNEL)
+        case SimdPath::avx2:
+            return lowPassRowAvx2(src, acc, fg, len, alpha, iThreshold, thresholds);
+#endif
+#if defined(__SSE2__)
+        case SimdPath::sse2:
+            return lowPassRowSse2(src, acc, fg, len, alpha, iThreshold, thresholds);
+#endif
+#if defined(__ARM_NEON)
+        case SimdPath::neon:
+            return lowPassRowNeon(src, acc, fg, len, alpha, iThreshold, thresholds);
+#endif
+        default:
+            return lowPassRowScalar(src, acc, fg, 0, len, alpha, iThreshold, thresholds);
+        }
+    });
+}
+
+
+int lowPassSegment(const cv::Mat& image, cv::Mat& accu, cv::Mat& mask,
+                   double alpha, double threshold, SimdPath path)
+{
+    return lowPassSegment(image, accu, mask, alpha, threshold, nullptr, path);
+}
+
+
+int lowPassSegment(const cv::Mat& image, cv::Mat& accu, cv::Mat& mask,
+                   double alpha, double threshold, SegmentStats& stats, SimdPath path)
+{
+    return lowPassSegment(image, accu, mask, alpha, threshold, &stats, path);
+}
+
+
+static int lowPassSegmentQ8(const cv::Mat& image, cv::Mat& accu, cv::Mat& mask,
+                            int shift, double threshold, SegmentStats* stats, SimdPath path)
+{
+    CV_Assert(image.type() == CV_8UC1 && accu.type() == CV_16U);
+    CV_Assert(image.rows == accu.rows && image.cols == accu.cols);
+    mask.create(image.rows, image.cols, CV_8UC1);
+    shift = shift < 1 ? 1 : shift;
+    shift = shift > 15 ? 15 : shift;
+    int iThreshold = stats && !stats->thresholds.empty()
+            ? segmentThreshold(0, path) : segmentThreshold(threshold, path);
+
+    return segmentBands(image, accu, mask, stats, [&](int row, int x, int len, const uchar* thresholds) {
+        const uchar* src = image.ptr<uchar>(row) + x;
+        ushort* acc = accu.ptr<ushort>(row) + x;
+        uchar* fg = mask.ptr<uchar>(row) + x;
+        switch (path) {
+#if defined(AVX2_KERNEL)
+        case SimdPath::avx2:
+            return lowPassRowQ8Avx2(src, acc, fg, len, shift, iThreshold, thresholds);
+#endif
+#if defined(__SSE2__)
+        case SimdPath::sse2:
+            return lowPassRowQ8Sse2(src, acc, fg, len, shift, iThreshold, thresholds);
+#endif
+#if defined(__ARM_NEON)
+        case SimdPath::neon:
+            return lowPassRowQ8Neon(src, acc, fg, len, shift, iThreshold, thresholds);
+#endif
+        default:
+            return lowPassRowQ8Scalar(src, acc, fg, 0, len, shift, iThreshold, thresholds);
+        }
+    });
+}
+
+
+int lowPassSegmentQ8(const cv::Mat& image, cv::Mat& accu, cv::Mat& mask,
+                     int shift, double threshold, SimdPath path)
+{
+    return lowPassSegmentQ8(image, accu, mask, shift, threshold, nullptr, path);
+}
+
+
+int lowPassSegmentQ8(const cv::Mat& image, cv::Mat& accu, cv::Mat& mask,
+                     int shift, double threshold, SegmentStats& stats, SimdPath path)
+{
+    return lowPassSegmentQ8(image, accu, mask, shift, threshold, &stats, path);
+}
+
+
+// not time critical (once per background reset): nth_element on values of each pixel
+void medianFrames(const std::vector<cv::Mat>& frames, cv::Mat& median)
+{
+    CV_Assert(!frames.empty());
+    cv::Size size = frames[0].size();
+    for (const cv::Mat& frame : frames)
+        CV_Assert(frame.type() == CV_8UC1 && frame.size() == size);
+    median.create(size, CV_8UC1);
+    std::vector<uchar> values(frames.size());
+    const size_t middle = frames.size() / 2;
+    for (int row = 0; row < size.height; ++row) {
+        uchar* dst = median.ptr<uchar>(row);
+        for (int x = 0; x < size.width; ++x) {
+            for (size_t n = 0; n < frames.size(); ++n)
+                values[n] = frames[n].ptr<uchar>(row)[x];
+            std::nth_element(values.begin(), values.begin() + static_cast<long>(middle), values.end());
+            dst[x] = values[middle];
+        }
+    }
+}
+
+
+// mask of other segmentation (e.g. opencv background subtractor): statistics in one sweep
+int maskStats(cv::Mat& mask, SegmentStats& stats)
+{
+    CV_Assert(mask.type() == CV_8UC1);
+    return segmentBands(mask, mask, mask, &stats, [&](int row, int x, int len, const uchar* thresholds) {
+        uchar* fg = mask.ptr<uchar>(row) + x;
+        int count = 0;
+        for (int i = 0; i < len; ++i) {
+            if (thresholds && thresholds[i] == UCHAR_MAX)
+                fg[i] = 0;
+            count += fg[i] ? 1 : 0;
+        }
+        return count;
+    });
+}
+
+
+void packMask(const cv::Mat& mask, cv::Mat& packed, SimdPath path)
+{
+    CV_Assert(mask.type() == CV_8UC1);
+    path = resolveSimdPath(path);
+    packed.create(mask.rows, packedWords(mask.cols) * 8, CV_8UC1);
+    for (int row = 0; row < mask.rows; ++row) {
+        const uchar* src = mask.ptr<uchar>(row);
+        uchar* dst = packed.ptr<uchar>(row);
+        // padding bits of last word
+        std::fill(dst + mask.cols / 8, dst + packed.cols, 0);
+        switch (path) {
+#if defined(AVX2_KERNEL)
+        case SimdPath::avx2:
+            packRowAvx2(src, dst, mask.cols);
+            break;
+#endif
+#if defined(__SSE2__)
+        case SimdPath::sse2:
+            packRowSse2(src, dst, mask.cols);
+            break;
+#endif
+#if defined(__ARM_NEON)
+        case SimdPath::neon:
+            packRowNeon(src, dst, mask.cols);
+            break;
+#endif
+        default:
+            packRowScalar(src, dst, 0, mask.cols);
+            break;
+        }
+    }
+}
+
+
+// area downscale of pooled row y: factor source rows summed vertically, then factor columns
+static void poolRow(const uchar* src, size_t srcStep, int factor, int y, cv::Mat& pooled,
+                    ushort* poolSum, SimdPath path)
+{
+    const int area = factor * factor;
+    const uint64_t poolScale = reciprocal(area);
+    const bool isHalfEven = factor != 2 && area % 2 == 0;
+    const int len = pooled.cols * factor;
+    std::fill(poolSum, poolSum + len, 0);
+    for (int k = 0; k < factor; ++k)
+        poolRowAdd(src + static_cast<size_t>(y * factor + k) * srcStep, poolSum, len, path);
+    uchar* dst = pooled.ptr<uchar>(y);
+    for (int x = 0; x < pooled.cols; ++x) {
+        uint32_t sum = 0;
+        const ushort* cell = poolSum + x * factor;
+        for (int k = 0; k < factor; ++k)
+            sum += cell[k];
+        dst[x] = poolMean(sum, area, poolScale, isHalfEven);
+    }
+}
+
+
+// box blur of row, pooled rows row - anchor ... row + kernel - 1 - anchor must be complete
+// isFirst: column sums from scratch, else running update from row - 1
+static void blurRow(const cv::Mat& pooled, int kernel, int row, bool isFirst,
+                    int* colSum, int* rowExt, cv::Mat& blurred)
+{
+    const int width = pooled.cols;
+    const int height = pooled.rows;
+    const int anchor = kernel / 2;
+    const int kernelArea = kernel * kernel;
+    const uint64_t blurScale = reciprocal(kernelArea);
+
+    // vertical: running column sums over rows row - anchor ... row + kernel - 1 - anchor
+    if (isFirst) {
+        std::fill(colSum, colSum + width, 0);
+        for (int v = row - anchor; v < row + kernel - anchor; ++v) {
+            const uchar* src = pooled.ptr<uchar>(reflect101(v, height));
+            for (int x = 0; x < width; ++x)
+                colSum[x] += src[x];
+        }
+    } else {
+        const uchar* enter = pooled.ptr<uchar>(reflect101(row + kernel - 1 - anchor, height));
+        const uchar* leave = pooled.ptr<uchar>(reflect101(row - 1 - anchor, height));
+        for (int x = 0; x < width; ++x)
+            colSum[x] += enter[x] - leave[x];
+    }
+
+    // horizontal: running sum over bordered column sums
+    for (int i = 0; i < width + kernel; ++i)
+        rowExt[i] = colSum[reflect101(i - anchor, width)];
+    uint32_t sum = 0;
+    for (int i = 0; i < kernel; ++i)
+        sum += static_cast<uint32_t>(rowExt[i]);
+    uchar* out = blurred.ptr<uchar>(row);
+    for (int x = 0; x < width; ++x) {
+        out[x] = static_cast<uchar>(((sum + static_cast<uint32_t>(kernelArea / 2)) * blurScale) >> 32);
+        sum += static_cast<uint32_t>(rowExt[x + kernel] - rowExt[x]);
+    }
+}
+
+
+/* source plane is read once: factor rows are summed vertically (simd), then horizontally
+ * box blur follows pooling with a delay of kernel rows, while pooled rows are still cached
+ * running column sums, border reflect 101 as cv::blur, rounded half up
+ * workers: pooling of stripes, then blur of stripes, that reads halo rows pooled by neighbours
+ * integer arithmetic: identical to serial */
+void poolBlur(const uchar* src, size_t srcStep, cv::Size srcSize, int factor, int kernel,
+              cv::Mat& pooled, cv::Mat& blurred, SimdPath path, WorkerPool* workers)
+{
+    // 16 bit column sums: factor^2 * 255 < 2^16
+    CV_Assert(factor >= 1 && factor <= 16);
+    path = resolveSimdPath(path);
+    cv::Size size(srcSize.width / factor, srcSize.height / factor);
+    pooled.create(size, CV_8UC1);
+    blurred.create(size, CV_8UC1);
+    if (size.area() == 0)
+        return;
+
+    kernel = std::min(kernel, std::min(size.width, size.height));
+    kernel = std::min(kernel, 63); // exact reciprocal
+    kernel = std::max(kernel, 1);
+    const int anchor = kernel / 2;
+
+    // scratch rows kept per thread (also per worker): no allocation per frame after first call
+    static thread_local std::vector<ushort> poolSum;
+    static thread_local std::vector<int> colSum, rowExt;
+    auto prepareScratch = [&]() {
+        poolSum.resize(static_cast<size_t>(size.width * factor));
+        colSum.resize(static_cast<size_t>(size.width));
+        rowExt.resize(static_cast<size_t>(size.width + kernel));
+    };
+
+    int stripes = workers ? std::min(workers->size(), size.height) : 1;
+    if (stripes > 1) {
+        auto poolStripe = [&](int n) {
+            prepareScratch();
+            for (int y = size.height * n / stripes; y < size.height * (n + 1) / stripes; ++y)
+                poolRow(src, srcStep, factor, y, pooled, poolSum.data(), path);
+        };
+        workers->run(stripes, poolStripe);
+        if (kernel < 2) {
+            pooled.copyTo(blurred);
+            return;
+        }
+        auto blurStripe = [&](int n) {
+            prepareScratch();
+            int first = size.height * n / stripes;
+            for (int row = first; row < size.height * (n + 1) / stripes; ++row)
+                blurRow(pooled, kernel, row, row == first, colSum.data(), rowExt.data(), blurred);
+        };
+        workers->run(stripes, blurStripe);
+        return;
+    }
+
+    prepareScratch();
+    int row = 0;
+    for (int y = 0; y < size.height; ++y) {
+        poolRow(src, srcStep, factor, y, pooled, poolSum.data(), path);
+        if (kernel < 2)
+            continue;
+
+        // box blur of rows, whose window of pooled rows is complete
+        for (; row < size.height; ++row) {
+            int needed = std::max(row + kernel - 1 - anchor, anchor);
+            if (std::min(needed, size.height - 1) > y)
+                break;
+            blurRow(pooled, kernel, row, row == 0, colSum.data(), rowExt.data(), blurred);
+        }
+    }
+    if (kernel < 2)
+        pooled.copyTo(blurred);
+}
+
+
+/* poolBlur with geometry as compile-time constants (serial path):
+ * loop bounds and reciprocals are constants, scratch rows are fixed size arrays,
+ * horizontal border (reflect 101) is resolved for anchor columns only, interior copied
+ * same integer arithmetic as poolRow, blurRow: identical to poolBlur */
+template <int Width, int Height, int Factor, int Kernel>
+static void poolBlurFixed(const uchar* src, size_t srcStep, cv::Mat& pooled, cv::Mat& blurred,
+                          SimdPath path)
+{
+    constexpr int cols = Width / Factor;
+    constexpr int rows = Height / Factor;
+    constexpr int area = Factor * Factor;
+    constexpr int anchor = Kernel / 2;
+    constexpr int kernelArea = Kernel * Kernel;
+    constexpr uint64_t poolScale = reciprocal(area);
+    constexpr bool isHalfEven = Factor != 2 && area % 2 == 0;
+    constexpr uint64_t blurScale = reciprocal(kernelArea);
+    static_assert(Factor >= 1 && Factor <= 16, "16 bit column sums");
+    static_assert(Kernel >= 2 && Kernel <= 63 && Kernel <= cols && Kernel <= rows, "box blur kernel");
+
+    pooled.create(rows, cols, CV_8UC1);
+    blurred.create(rows, cols, CV_8UC1);
+    static thread_local std::array<ushort, cols * Factor> poolSum;
+    static thread_local std::array<int, cols> colSum;
+    static thread_local std::array<int, cols + Kernel> rowExt;
+
+    int row = 0;
+    for (int y = 0; y < rows; ++y) {
+        // area downscale: Factor source rows, then Factor columns (unrolled)
+        poolSum.fill(0);
+        for (int k = 0; k < Factor; ++k)
+            poolRowAdd(src + static_cast<size_t>(y * Factor + k) * srcStep, poolSum.data(), cols * Factor, path);
+        uchar* dst = pooled.ptr<uchar>(y);
+        for (int x = 0; x < cols; ++x) {
+            uint32_t sum = 0;
+            for (int k = 0; k < Factor; ++k)
+                sum += poolSum[static_cast<size_t>(x * Factor + k)];
+            dst[x] = poolMean(sum, area, poolScale, isHalfEven);
+        }
+
+        // box blur of rows, whose window of pooled rows is complete
+        for (; row < rows; ++row) {
+            if (std::min(std::max(row + Kernel - 1 - anchor, anchor), rows - 1) > y)
+                break;
+            if (row == 0) {
+                colSum.fill(0);
+                for (int v = -anchor; v < Kernel - anchor; ++v) {
+                    const uchar* line = pooled.ptr<uchar>(reflect101(v, rows));
+                    for (int x = 0; x < cols; ++x)
+                        colSum[static_cast<size_t>(x)] += line[x];
+                }
+            } else {
+                const uchar* enter = pooled.ptr<uchar>(reflect101(row + Kernel - 1 - anchor, rows));
+                const uchar* leave = pooled.ptr<uchar>(reflect101(row - 1 - anchor, rows));
+                for (int x = 0; x < cols; ++x)
+                    colSum[static_cast<size_t>(x)] += enter[x] - leave[x];
+            }
+            std::copy(colSum.begin(), colSum.end(), rowExt.begin() + anchor);
+            for (int i = 0; i < anchor; ++i)
+                rowExt[static_cast<size_t>(i)] = colSum[static_cast<size_t>(reflect101(i - anchor, cols))];
+            for (int i = cols + anchor; i < cols + Kernel; ++i)
+                rowExt[static_cast<size_t>(i)] = colSum[static_cast<size_t>(reflect101(i - anchor, cols))];
+            uint32_t sum = 0;
+            for (int i = 0; i < Kernel; ++i)
+                sum += static_cast<uint32_t>(rowExt[static_cast<size_t>(i)]);
+            uchar* out = blurred.ptr<uchar>(row);
+            for (int x = 0; x < cols; ++x) {
+                out[x] = static_cast<uchar>(((sum + kernelArea / 2) * blurScale) >> 32);
+                sum += static_cast<uint32_t>(rowExt[static_cast<size_t>(x + Kernel)] - rowExt[static_cast<size_t>(x)]);
+            }
+        }
+    }
+}
+
+
+/* geometries of camera fleet: 1920x1080 and 2560x1440, scale 0.25 and 0.5,
+ * kernel as chosen by MotionDetector (analysed width / 96) */
+struct FixedGeometry
+{
+    int     width;
+    int     height;
+    int     factor;
+    int     kernel;
+    void    (*poolBlur)(const uchar* src, size_t srcStep, cv::Mat& pooled, cv::Mat& blurred, SimdPath path);
+};
+
+static const FixedGeometry fixedGeometries[] = {
+    {1920, 1080, 4,  5, poolBlurFixed<1920, 1080, 4,  5>},
+    {1920, 1080, 2, 10, poolBlurFixed<1920, 1080, 2, 10>},
+    {2560, 1440, 4,  6, poolBlurFixed<2560, 1440, 4,  6>},
+    {2560, 1440, 2, 13, poolBlurFixed<2560, 1440, 2, 13>}
+};
+
+
+bool poolBlurFixed(const uchar* src, size_t srcStep, cv::Size srcSize, int factor, int kernel,
+                   cv::Mat& pooled, cv::Mat& blurred, SimdPath path)
+{
+    for (const FixedGeometry& geometry : fixedGeometries) {
+        if (geometry.width == srcSize.width && geometry.height == srcSize.height
+                && geometry.factor == factor && geometry.kernel == kernel) {
+            geometry.poolBlur(src, srcStep, pooled, blurred, resolveSimdPath(path));
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// builtin popcount: popcnt (x86 with -mpopcnt), cnt (neon), else bit twiddling
+int popcountMask(const cv::Mat& packed)
+{
+    CV_Assert(packed.type() == CV_8UC1 && packed.cols % 8 == 0);
+    int count = 0;
+    for (int row = 0; row < packed.rows; ++row) {
+        const uint64_t* words = packed.ptr<uint64_t>(row);
+        for (int w = 0; w < packed.cols / 8; ++w)
+            count += __builtin_popcountll(words[w]);
+    }
+    return count;
+}
+
+
+int popcountMask(const cv::Mat& packed, const cv::Mat& select)
+{
+    CV_Assert(packed.type() == CV_8UC1 && packed.cols % 8 == 0 && select.size() == packed.size());
+    int count = 0;
+    for (int row = 0; row < packed.rows; ++row) {
+        const uint64_t* words = packed.ptr<uint64_t>(row);
+        const uint64_t* selected = select.ptr<uint64_t>(row);
+        for (int w = 0; w < packed.cols / 8; ++w)
+            count += __builtin_popcountll(words[w] & selected[w]);
+    }
+    return count;
+}
+
+
+SimdPath resolveSimdPath(SimdPath path)
+{
+    if (path != SimdPath::best)
+        return isSimdPathSupported(path) ? path : SimdPath::scalar;
+
+    if (isSimdPathSupported(SimdPath::avx2))
+        return SimdPath::avx2;
+    if (isSimdPathSupported(SimdPath::sse2))
+        return SimdPath::sse2;
+    if (isSimdPathSupported(SimdPath::neon))
+        return SimdPath::neon;
+    return SimdPath::scalar;
+}
+
+
+const char* simdPathName(SimdPath path)
+{
+    switch (path) {
+    case SimdPath::best:
+        return "best";
+    case SimdPath::scalar:
+        return "scalar";
+    case SimdPath::sse2:
+        return "sse2";
+    case SimdPath::avx2:
+        return "avx2";
+    case SimdPath::neon:
+        return "neon";
+    }
+    return "unknown";
+}
+
+
+/* bit sliced counting: atLeast[j] holds bits set in at least j of the masks seen so far
+ * adding mask m: atLeast[j] |= atLeast[j - 1] & m, for j = votes ... 1 */
+void voteMasks(const cv::Mat& history, int frames, int votes, cv::Mat& voted)
+{
+    CV_Assert(history.type() == CV_8UC1 && history.cols % 8 == 0 && history.isContinuous());
+    CV_Assert(frames >= 1 && frames <= 32 && history.rows % frames == 0);
+    votes = std::min(std::max(votes, 1), frames);
+    const int rows = history.rows / frames;
+    voted.create(rows, history.cols, CV_8UC1);
+    CV_Assert(voted.isContinuous());
+
+    const size_t words = static_cast<size_t>(rows) * static_cast<size_t>(history.cols / 8);
+    const uint64_t* planes = history.ptr<uint64_t>();
+    uint64_t* dst = voted.ptr<uint64_t>();
+    uint64_t atLeast[33];
+    for (size_t w = 0; w < words; ++w) {
+        atLeast[0] = ~uint64_t(0);
+        std::fill(atLeast + 1, atLeast + votes + 1, 0);
+        for (int f = 0; f < frames; ++f) {
+            uint64_t m = planes[static_cast<size_t>(f) * words + w];
+            for (int j = std::min(f + 1, votes); j >= 1; --j)
+                atLeast[j] |= atLeast[j - 1] & m;
+        }
+        dst[w] = atLeast[votes];
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef DETECTIONKERNELS_H
+#define DETECTIONKERNELS_H
+#include <opencv2/opencv.hpp>
+
+/* instruction set of fused kernels
+ * best: fastest path supported by cpu (runtime detection of avx2) */
+enum class SimdPath {best, scalar, sse2, avx2, neon};
+
+class WorkerPool;
+
+
+// CLASSES
+/* statistics of segmentation, counted band by band while mask rows are still cached
+ * thresholds replace threshold parameter: pixel is foreground, if difference > value (255: never) */
+struct SegmentStats
+{
+    cv::Mat             cells;      // out: foreground count per cellSize x cellSize block, CV_32S
+    cv::Mat             skipCells;  // in:  per cell, != 0: not segmented (mask 0, background kept), CV_8U
+    cv::Mat             labels;     // in:  zone per pixel, CV_8U, empty: no zones
+    cv::Mat             thresholds; // in:  threshold per pixel, CV_8U, empty: threshold parameter
+    std::vector<int>    zoneCounts; // out: foreground count per label (256 entries)
+    int                 cellSize;   // in:  0: no cells, partial cells at right and bottom border
+    char                avoidPaddingWarning1[4];
+};
+
+
+// FUNCTIONS
+/* packed masks: 1 bit per pixel, bit x % 64 of 64 bit word x / 64 (little endian)
+ * stored as CV_8UC1 of (width + 63) / 64 * 8 bytes per row, padding bits are 0 */
+/* foreground bits per cellSize x cellSize block of packed mask, CV_32S
+ * as cell counts of SegmentStats, width: pixels per row of unpacked mask */
+void        countPackedCells(const cv::Mat& packed, int width, int cellSize, cv::Mat& cells);
+/* frame differencing, single sweep: previous frame is background, 8 bit
+ * mask = |image - previous| > threshold ? 255 : 0, previous = image
+ * returns number of foreground pixels, stats as lowPassSegment */
+int         frameDiffSegment(const cv::Mat& image, cv::Mat& previous, cv::Mat& mask,
+                             double threshold, SimdPath path = SimdPath::best);
+int         frameDiffSegment(const cv::Mat& image, cv::Mat& previous, cv::Mat& mask,
+                             double threshold, SegmentStats& stats, SimdPath path = SimdPath::best);
+bool        isSimdPathSupported(SimdPath path);
+/* fused low pass background update and segmentation, single sweep over frame
+ * accu = accu * (1 - alpha) + image * alpha
+ * mask = |image - round(accu)| > threshold ? 255 : 0
+ * returns number of foreground pixels
+ * bit compatible with accumulateWeighted, convertScaleAbs, absdiff, threshold, countNonZero
+ * of an opencv build using the same instruction set */
+int         lowPassSegment(const cv::Mat& image, cv::Mat& accu, cv::Mat& mask,
+                           double alpha, double threshold, SimdPath path = SimdPath::best);
+/* with statistics and optional per pixel thresholds, see SegmentStats
+ * bit compatible as above, if cellSize * width is a multiple of 32 (e.g. 16 and even width) */
+int         lowPassSegment(const cv::Mat& image, cv::Mat& accu, cv::Mat& mask,
+                           double alpha, double threshold, SegmentStats& stats,
+                           SimdPath path = SimdPath::best);
+/* fixed point variant, background as Q8.8 in 16 bit, alpha = 2^-shift
+ * accu = accu + (image * 256 - accu) / 2^shift, truncated towards zero
+ * mask = |image - round(accu / 256)| > threshold ? 255 : 0
+ * integer arithmetic only: all paths give identical results */
+int         lowPassSegmentQ8(const cv::Mat& image, cv::Mat& accu, cv::Mat& mask,
+                             int shift, double threshold, SimdPath path = SimdPath::best);
+int         lowPassSegmentQ8(const cv::Mat& image, cv::Mat& accu, cv::Mat& mask,
+                             int shift, double threshold, SegmentStats& stats,
+                             SimdPath path = SimdPath::best);
+/* per pixel median of 8 bit frames of same size, e.g. background seed w/o transient objects
+ * even number of frames: upper median */
+void        medianFrames(const std::vector<cv::Mat>& frames, cv::Mat& median);
+/* statistics of mask segmented otherwise (0 or 255), pixels with threshold 255 are cleared
+ * returns number of foreground pixels */
+int         maskStats(cv::Mat& mask, SegmentStats& stats);
+/* mask (0 or 255) -> packed mask, 8x smaller */
+void        packMask(const cv::Mat& mask, cv::Mat& packed, SimdPath path = SimdPath::best);
+/* area downscale by integer factor and box blur in one sweep over 8 bit plane
+ * src, srcStep: plane with row stride, e.g. AVFrame data[0], linesize[0]
+ * pooled = mean of factor x factor pixels, size = srcSize / factor, rounded as resize INTER_AREA
+ * (factor 2: half up, else half to even, equal for power of two factors)
+ * blurred = kernel x kernel box filter of pooled, border reflect 101 as blur, rounded half up
+ * (blur may differ by one gray level at exact halves), kernel < 2: copy
+ * workers: stripes of rows in parallel, result identical to serial */
+void        poolBlur(const uchar* src, size_t srcStep, cv::Size srcSize, int factor, int kernel,
+                     cv::Mat& pooled, cv::Mat& blurred, SimdPath path = SimdPath::best,
+                     WorkerPool* workers = nullptr);
+/* poolBlur specialised for fixed geometries (1920x1080, 2560x1440 at factor 4 and 2, kernel
+ * width / factor / 96): source size, factor and kernel are compile-time constants, serial
+ * result identical to poolBlur, false: geometry not specialised, nothing done (use poolBlur) */
+bool        poolBlurFixed(const uchar* src, size_t srcStep, cv::Size srcSize, int factor, int kernel,
+                          cv::Mat& pooled, cv::Mat& blurred, SimdPath path = SimdPath::best);
+/* foreground bits by popcount, select: packed mask of same size, e.g. zone */
+int         popcountMask(const cv::Mat& packed);
+int         popcountMask(const cv::Mat& packed, const cv::Mat& select);
+SimdPath    resolveSimdPath(SimdPath path);
+const char* simdPathName(SimdPath path);
+/* k of n temporal voting: bit is set, if set in at least votes of frames packed masks
+ * history: frames packed masks stacked vertically, bitwise and / or only */
+void        voteMasks(const cv::Mat& history, int frames, int votes, cv::Mat& voted);
+
+
+#endif // DETECTIONKERNELS_H
@@ -0,0 +1,264 @@
+#include "detector-engines.h"
+
+
+// MODELS
+void LowPassModel::background(cv::Mat& image) const
+{
+    accu.convertTo(image, CV_8U);
+}
+
+
+void LowPassModel::init(const cv::Mat& frame)
+{
+    frame.convertTo(accu, CV_32F);
+}
+
+
+int LowPassModel::segment(const cv::Mat& frame, cv::Mat& mask, double alpha, double threshold,
+                          SegmentStats& stats)
+{
+    return lowPassSegment(frame, accu, mask, alpha, threshold, stats);
+}
+
+
+void RunningAverageModel::background(cv::Mat& image) const
+{
+    accu.convertTo(image, CV_8U, 1.0 / 256);
+}
+
+
+void RunningAverageModel::init(const cv::Mat& frame)
+{
+    frame.convertTo(accu, CV_16U, 256);
+}
+
+
+// alpha = 2^-shift, nearest in log scale
+int RunningAverageModel::segment(const cv::Mat& frame, cv::Mat& mask, double alpha, double threshold,
+                                 SegmentStats& stats)
+{
+    int shift = alpha > 0 ? cvRound(-std::log2(alpha)) : 15;
+    return lowPassSegmentQ8(frame, accu, mask, shift, threshold, stats);
+}
+
+
+void FrameDiffModel::background(cv::Mat& image) const
+{
+    accu.copyTo(image);
+}
+
+
+void FrameDiffModel::init(const cv::Mat& frame)
+{
+    frame.copyTo(accu);
+}
+
+
+// alpha not used: background is replaced by each frame
+int FrameDiffModel::segment(const cv::Mat& frame, cv::Mat& mask, double alpha, double threshold,
+                            SegmentStats& stats)
+{
+    (void)alpha;
+    return frameDiffSegment(frame, accu, mask, threshold, stats);
+}
+
+
+
+// gray level difference -> squared Mahalanobis distance of MOG2 at variance of a new mode:
+// varThreshold = threshold^2 / varInit, e.g. 40 -> 107 (opencv default 16: 15.5 gray levels)
+// variances learned per mode scale the effective difference per pixel
+static cv::Ptr<cv::BackgroundSubtractorMOG2> createMog2(double threshold)
+{
+    cv::Ptr<cv::BackgroundSubtractorMOG2> mog2 = cv::createBackgroundSubtractorMOG2(500, 16, false);
+    mog2->setVarThreshold(threshold * threshold / mog2->getVarInit());
+    return mog2;
+}
+
+
+
+// CLASS IMPLEMENTATION
+Mog2Engine::Mog2Engine(double alpha, double threshold) :
+    m_alpha(alpha),
+    m_foregroundCount(0),
+    m_isReset(false),
+    m_stats{cv::Mat(), cv::Mat(), cv::Mat(), cv::Mat(), std::vector<int>(), 16, {0}},
+    m_threshold(threshold)
+{
+    m_mog2 = createMog2(threshold);
+}
+
+
+cv::Mat Mog2Engine::accumulator() const
+{
+    return cv::Mat();
+}
+
+
+bool Mog2Engine::accumulator(const cv::Mat& accu)
+{
+    (void)accu;
+    return false;
+}
+
+
+double Mog2Engine::alpha() const
+{
+    return m_alpha;
+}
+
+
+void Mog2Engine::alpha(double alpha)
+{
+    m_alpha = alpha;
+}
+
+
+int Mog2Engine::apply(const cv::Mat& frame, cv::Mat& mask, double learningRate, WorkerPool* workers)
+{
+    (void)workers;
+    if (frame.size() != m_size) {
+        resetSegmentStats(m_stats, frame.size());
+        m_size = frame.size();
+    }
+    if (m_stats.labels.size() != frame.size()) {
+        m_stats.labels.release();
+        m_stats.thresholds.release();
+    }
+    // restarted mixture has no modes: frame is learned as background, mask cleared
+    // (segmented, each pixel would be foreground)
+    if (m_isReset) {
+        m_mog2->apply(frame, mask, 1);
+        mask.setTo(cv::Scalar(0));
+        m_isReset = false;
+        m_foregroundCount = maskStats(mask, m_stats);
+        return m_foregroundCount;
+    }
+    m_mog2->apply(frame, mask, learningRate < 0 ? m_alpha : learningRate);
+    // cells and zones: second sweep over mask
+    m_foregroundCount = maskStats(mask, m_stats);
+    return m_foregroundCount;
+}
+
+
+void Mog2Engine::background(cv::Mat& image) const
+{
+    m_mog2->getBackgroundImage(image);
+}
+
+
+int Mog2Engine::foregroundCount() const
+{
+    return m_foregroundCount;
+}
+
+
+void Mog2Engine::refresh(const cv::Mat& frame, cv::Rect rect)
+{
+    (void)frame;
+    (void)rect;
+}
+
+
+// learned modes discarded: mixture restarts empty
+void Mog2Engine::reset()
+{
+    m_mog2 = createMog2(m_threshold);
+    m_isReset = true;
+}
+
+
+// background image learned with rate 1 by restarted mixture, pending reset done
+void Mog2Engine::seed(const cv::Mat& background)
+{
+    m_mog2 = createMog2(m_threshold);
+    cv::Mat mask;
+    m_mog2->apply(background, mask, 1);
+    m_isReset = false;
+}
+
+
+SegmentStats& Mog2Engine::stats()
+{
+    return m_stats;
+}
+
+
+double Mog2Engine::threshold() const
+{
+    return m_threshold;
+}
+
+
+void Mog2Engine::threshold(double threshold)
+{
+    m_threshold = threshold;
+    m_mog2->setVarThreshold(threshold * threshold / m_mog2->getVarInit());
+}
+
+
+
+// FUNCTIONS
+DetectorEngine createDetectorEngine(EngineType type, double alpha, double threshold)
+{
+    switch (type) {
+    case EngineType::runningAverage:
+        return SegmentEngine<RunningAverageModel>(alpha, threshold);
+    case EngineType::frameDiff:
+        return SegmentEngine<FrameDiffModel>(alpha, threshold);
+    case EngineType::mog2:
+        return Mog2Engine(alpha, threshold);
+    case EngineType::lowPass:
+        break;
+    }
+    return SegmentEngine<LowPassModel>(alpha, threshold);
+}
+
+
+const char* engineName(EngineType type)
+{
+    switch (type) {
+    case EngineType::lowPass:
+        return "lowPass";
+    case EngineType::runningAverage:
+        return "runningAverage";
+    case EngineType::frameDiff:
+        return "frameDiff";
+    case EngineType::mog2:
+        return "mog2";
+    }
+    return "unknown";
+}
+
+
+EngineType engineFromName(const std::string& name)
+{
+    for (EngineType type : {EngineType::runningAverage, EngineType::frameDiff, EngineType::mog2}) {
+        if (name == engineName(type))
+            return type;
+    }
+    return EngineType::lowPass;
+}
+
+
+// alternatives of DetectorEngine in order of EngineType
+EngineType engineType(const DetectorEngine& engine)
+{
+    return static_cast<EngineType>(engine.index());
+}
+
+
+void resetSegmentStats(SegmentStats& stats, cv::Size frameSize)
+{
+    int cellSize = stats.cellSize;
+    if (cellSize > 0) {
+        stats.cells.create((frameSize.height + cellSize - 1) / cellSize,
+                           (frameSize.width + cellSize - 1) / cellSize, CV_32S);
+        stats.cells.setTo(cv::Scalar(0));
+    } else {
+        stats.cells.release();
+    }
+    // cells skipped in frame of other size are meaningless
+    if (stats.skipCells.size() != stats.cells.size())
+        stats.skipCells.release();
+    stats.zoneCounts.assign(UCHAR_MAX + 1, 0);
+}
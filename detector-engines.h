@@ -0,0 +1,319 @@
+#ifndef DETECTORENGINES_H
+#define DETECTORENGINES_H
+#include "detection-kernels.h"
+#include "workerpool.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <numeric> // gcd
+#include <variant>
+
+/* segmentation engine of MotionDetector
+ * lowPass:        first order low pass, float accumulator (default)
+ * runningAverage: integer running average, Q8.8 in 16 bit, alpha rounded to power of two
+ * frameDiff:      difference to previous frame, no learning
+ * mog2:           opencv gaussian mixture, cells and zones counted in extra sweep */
+enum class EngineType {lowPass, runningAverage, frameDiff, mog2};
+
+
+// CLASSES
+/* models of SegmentEngine (policy), same members, no common base class
+ * accuType:   type of accu, e.g. to validate saved background
+ * init:       background from first frame
+ * segment:    update background and segment frame in one sweep, returns foreground count
+ * background: 8 bit background image */
+struct LowPassModel
+{
+    cv::Mat     accu; // CV_32F
+    static constexpr int accuType = CV_32F;
+    void        background(cv::Mat& image) const;
+    void        init(const cv::Mat& frame);
+    int         segment(const cv::Mat& frame, cv::Mat& mask, double alpha, double threshold,
+                        SegmentStats& stats);
+};
+
+
+struct RunningAverageModel
+{
+    cv::Mat     accu; // Q8.8 in CV_16U
+    static constexpr int accuType = CV_16U;
+    void        background(cv::Mat& image) const;
+    void        init(const cv::Mat& frame);
+    int         segment(const cv::Mat& frame, cv::Mat& mask, double alpha, double threshold,
+                        SegmentStats& stats);
+};
+
+
+struct FrameDiffModel
+{
+    cv::Mat     accu; // previous frame, CV_8U
+    static constexpr int accuType = CV_8U;
+    void        background(cv::Mat& image) const;
+    void        init(const cv::Mat& frame);
+    int         segment(const cv::Mat& frame, cv::Mat& mask, double alpha, double threshold,
+                        SegmentStats& stats);
+};
+
+
+/// background model and statistics of segmentation (cells, zones)
+/// model as template parameter: segment call of hot path is resolved at compile time
+template <class Model> class SegmentEngine
+{
+public:
+    SegmentEngine(double alpha, double threshold) :
+        m_alpha(alpha),
+        m_foregroundCount(0),
+        m_isInitialized(false),
+        m_stats{cv::Mat(), cv::Mat(), cv::Mat(), cv::Mat(), std::vector<int>(), 16, {0}},
+        m_threshold(threshold)
+    {
+
+    }
+
+    /* background accumulator of model, see accuType, empty: not initialized */
+    cv::Mat accumulator() const
+    {
+        return m_isInitialized ? m_model.accu : cv::Mat();
+    }
+
+    /* background from saved accumulator, false: type does not match model */
+    bool accumulator(const cv::Mat& accu)
+    {
+        if (accu.empty() || accu.type() != Model::accuType)
+            return false;
+        accu.copyTo(m_model.accu);
+        resetSegmentStats(m_stats, accu.size());
+        m_foregroundCount = 0;
+        m_isInitialized = true;
+        return true;
+    }
+
+    double alpha() const
+    {
+        return m_alpha;
+    }
+
+    void alpha(double alpha)
+    {
+        m_alpha = alpha;
+    }
+
+    /* learningRate < 0: use alpha
+     * first frame or frame of other size (roi, scale) restarts background
+     * workers: horizontal stripes segmented in parallel, results identical to serial */
+    int apply(const cv::Mat& frame, cv::Mat& mask, double learningRate = -1,
+              WorkerPool* workers = nullptr)
+    {
+        double alpha = learningRate < 0 ? m_alpha : learningRate;
+        if (!m_isInitialized || frame.size() != m_model.accu.size()) {
+            m_model.init(frame);
+            mask.create(frame.size(), CV_8UC1);
+            mask.setTo(cv::Scalar(0));
+            resetSegmentStats(m_stats, frame.size());
+            m_foregroundCount = 0;
+            m_isInitialized = true;
+        } else {
+            // zone maps of other frame size (roi or scale changed) are not applied
+            if (m_stats.labels.size() != frame.size()) {
+                m_stats.labels.release();
+                m_stats.thresholds.release();
+            }
+            if (workers && workers->size() > 1)
+                m_foregroundCount = segmentStripes(frame, mask, alpha, *workers);
+            else
+                m_foregroundCount = m_model.segment(frame, mask, alpha, m_threshold, m_stats);
+        }
+        return m_foregroundCount;
+    }
+
+    void background(cv::Mat& image) const
+    {
+        m_model.background(image);
+    }
+
+    int foregroundCount() const
+    {
+        return m_foregroundCount;
+    }
+
+    /* background of rect replaced by frame, e.g. cells not segmented for a long time */
+    void refresh(const cv::Mat& frame, cv::Rect rect)
+    {
+        if (!m_isInitialized || frame.size() != m_model.accu.size())
+            return;
+        rect &= cv::Rect(cv::Point(0, 0), frame.size());
+        // model as view: init converts into accumulator of same size and type in place
+        Model part;
+        part.accu = m_model.accu(rect);
+        part.init(frame(rect));
+    }
+
+    /* background restarts with next frame */
+    void reset()
+    {
+        m_isInitialized = false;
+    }
+
+    /* background from image (e.g. median of frames), next frames are segmented against it */
+    void seed(const cv::Mat& background)
+    {
+        m_model.init(background);
+        resetSegmentStats(m_stats, background.size());
+        m_foregroundCount = 0;
+        m_isInitialized = true;
+    }
+
+    /* cellSize, zone maps: in, cells, zone counts: out, see SegmentStats */
+    SegmentStats& stats()
+    {
+        return m_stats;
+    }
+
+    double threshold() const
+    {
+        return m_threshold;
+    }
+
+    void threshold(double threshold)
+    {
+        m_threshold = threshold;
+    }
+
+private:
+    /* stripe borders on band borders of serial sweep: multiple of cellSize rows,
+     * w/o cells stripe size (rows * width) multiple of 32 pixels (vector body and tail as serial)
+     * each stripe: views of frame, background, mask, cells and zone maps, own zone counts
+     * counts reduced in order of stripes */
+    int segmentStripes(const cv::Mat& frame, cv::Mat& mask, double alpha, WorkerPool& workers)
+    {
+        const int cellSize = m_stats.cellSize;
+        const int align = cellSize > 0 ? cellSize : 32 / std::gcd(frame.cols, 32);
+        const int units = (frame.rows + align - 1) / align;
+        const int stripes = std::min(workers.size(), units);
+        const bool hasLabels = !m_stats.labels.empty();
+        const bool hasThresholds = !m_stats.thresholds.empty();
+        const bool hasSkip = cellSize > 0 && !m_stats.skipCells.empty();
+
+        mask.create(frame.size(), CV_8UC1);
+        if (cellSize > 0)
+            m_stats.cells.create(units, (frame.cols + cellSize - 1) / cellSize, CV_32S);
+        if (static_cast<int>(m_stripes.size()) < stripes)
+            m_stripes.resize(static_cast<size_t>(stripes));
+
+        auto segmentStripe = [&](int n) {
+            int first = std::min(units * n / stripes * align, frame.rows);
+            int last = std::min(units * (n + 1) / stripes * align, frame.rows);
+            Stripe& stripe = m_stripes[static_cast<size_t>(n)];
+            stripe.model.accu = m_model.accu.rowRange(first, last);
+            stripe.mask = mask.rowRange(first, last);
+            SegmentStats& stats = stripe.stats;
+            stats.cellSize = cellSize;
+            if (cellSize > 0)
+                stats.cells = m_stats.cells.rowRange(first / cellSize, (last + cellSize - 1) / cellSize);
+            if (hasSkip)
+                stats.skipCells = m_stats.skipCells.rowRange(first / cellSize, (last + cellSize - 1) / cellSize);
+            else
+                stats.skipCells.release();
+            if (hasLabels)
+                stats.labels = m_stats.labels.rowRange(first, last);
+            else
+                stats.labels.release();
+            if (hasThresholds)
+                stats.thresholds = m_stats.thresholds.rowRange(first, last);
+            else
+                stats.thresholds.release();
+            stripe.count = stripe.model.segment(frame.rowRange(first, last), stripe.mask,
+                                                alpha, m_threshold, stats);
+        };
+        workers.run(stripes, segmentStripe);
+
+        int count = 0;
+        if (hasLabels)
+            m_stats.zoneCounts.assign(UCHAR_MAX + 1, 0);
+        for (int n = 0; n < stripes; ++n) {
+            const Stripe& stripe = m_stripes[static_cast<size_t>(n)];
+            count += stripe.count;
+            if (hasLabels) {
+                for (size_t label = 0; label < m_stats.zoneCounts.size(); ++label)
+                    m_stats.zoneCounts[label] += stripe.stats.zoneCounts[label];
+            }
+        }
+        return count;
+    }
+
+    // model of stripe shares background of engine (views), kept for next frame
+    struct Stripe
+    {
+        Model           model;
+        cv::Mat         mask;
+        SegmentStats    stats{cv::Mat(), cv::Mat(), cv::Mat(), cv::Mat(), std::vector<int>(), 0, {0}};
+        int             count = 0;
+        char            avoidPaddingWarning1[4];
+    };
+
+    double          m_alpha;
+    int             m_foregroundCount;
+    bool            m_isInitialized;
+    char            avoidPaddingWarning1[3];
+    Model           m_model;
+    SegmentStats    m_stats;
+    std::vector<Stripe> m_stripes;
+    double          m_threshold;
+};
+
+
+/// opencv MOG2 with SegmentEngine members, e.g. as reference of detection quality
+/// alpha: learning rate, no shadows, threshold: gray level difference as of other engines,
+/// converted to varThreshold (squared Mahalanobis distance) at variance of a new mode
+/// thresholds of zones are not applied per pixel, pixels outside of zones are cleared
+class Mog2Engine
+{
+public:
+    Mog2Engine(double alpha, double threshold);
+    /* gaussian mixture is not exported: empty, restore fails */
+    cv::Mat     accumulator() const;
+    bool        accumulator(const cv::Mat& accu);
+    double      alpha() const;
+    void        alpha(double alpha);
+    /* workers not used: opencv parallelizes MOG2 itself */
+    int         apply(const cv::Mat& frame, cv::Mat& mask, double learningRate = -1,
+                      WorkerPool* workers = nullptr);
+    void        background(cv::Mat& image) const;
+    int         foregroundCount() const;
+    /* not used: skipped cells are cleared in mask only, gaussian mixture keeps learning */
+    void        refresh(const cv::Mat& frame, cv::Rect rect);
+    /* gaussian mixture restarts, next frame is learned as background, its mask is empty */
+    void        reset();
+    void        seed(const cv::Mat& background);
+    SegmentStats& stats();
+    double      threshold() const;
+    void        threshold(double threshold);
+private:
+    double      m_alpha;
+    int         m_foregroundCount;
+    bool        m_isReset;
+    char        avoidPaddingWarning1[3];
+    cv::Ptr<cv::BackgroundSubtractorMOG2> m_mog2;
+    cv::Size    m_size;
+    SegmentStats m_stats;
+    double      m_threshold;
+};
+
+
+/* all engines by value, std::visit once per frame instead of virtual calls per method */
+typedef std::variant<SegmentEngine<LowPassModel>, SegmentEngine<RunningAverageModel>,
+                     SegmentEngine<FrameDiffModel>, Mog2Engine> DetectorEngine;
+
+
+// FUNCTIONS
+DetectorEngine  createDetectorEngine(EngineType type, double alpha, double threshold);
+/* name as in settings: lowPass, runningAverage, frameDiff, mog2 */
+const char*     engineName(EngineType type);
+/* unknown name: lowPass */
+EngineType      engineFromName(const std::string& name);
+EngineType      engineType(const DetectorEngine& engine);
+/* cells zeroed in size of frame, zone counts zeroed */
+void            resetSegmentStats(SegmentStats& stats, cv::Size frameSize);
+
+
+#endif // DETECTORENGINES_H
@@ -0,0 +1,134 @@
+#ifndef FRAMERING_H
+#define FRAMERING_H
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+#include <algorithm> // max
+#include <array>
+#include <condition_variable>
+#include <mutex>
+
+
+/// decoded frame handed over from decode stage to detect stage
+struct StageFrame
+{
+    AVFrame*    frame;          // reference to decoder buffer (av_frame_ref), no copy
+    double      packetScore;    // max. packet size score of packets decoded for frame
+    double      timeStamp;      // seconds, < 0: none
+    int         frameStep;      // frames decoded since last published frame, dropped ones included
+    int         futureDistance; // frames to references of motion vectors (see frameMotionVectors)
+    int         pastDistance;
+    unsigned    streamGeneration; // of stream the frame was decoded from
+};
+
+
+/// bounded ring of recycled frames between decode stage and detect stage
+/// decode stage fills a free slot and publishes it as newest frame, a newest frame not taken
+/// yet is dropped (slot recycled, its frame step carried over): detect stage always analyses
+/// the newest frame, decoding never waits for detection
+/// 3 slots: one analysed, one published, one filled
+class FrameRing
+{
+public:
+    FrameRing() :
+        m_dropped(0),
+        m_fill(0),
+        m_newest(-1),
+        m_taken(-1),
+        m_terminate(false)
+    {
+        for (StageFrame& slot : m_slots)
+            slot = StageFrame{av_frame_alloc(), 0, -1, 0, 1, 1, 0};
+    }
+
+    ~FrameRing()
+    {
+        for (StageFrame& slot : m_slots)
+            av_frame_free(&slot.frame);
+    }
+
+    FrameRing(const FrameRing&) = delete;
+    FrameRing& operator=(const FrameRing&) = delete;
+
+    /* decode stage: frames of detect stage dropped since last call */
+    int dropped()
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        int dropped = m_dropped;
+        m_dropped = 0;
+        return dropped;
+    }
+
+    /* decode stage: slot to be filled, neither published nor analysed, frame unreferenced
+     * slot is free again, if it is not published */
+    StageFrame& fill()
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_fill = 0;
+        while (m_fill == m_newest || m_fill == m_taken)
+            ++m_fill;
+        StageFrame& slot = m_slots[static_cast<size_t>(m_fill)];
+        av_frame_unref(slot.frame);
+        return slot;
+    }
+
+    /* decode stage: filled slot becomes newest frame, replaces newest frame not taken yet */
+    void publish()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            StageFrame& slot = m_slots[static_cast<size_t>(m_fill)];
+            if (m_newest >= 0) {
+                StageFrame& skipped = m_slots[static_cast<size_t>(m_newest)];
+                slot.frameStep += skipped.frameStep;
+                slot.packetScore = std::max(slot.packetScore, skipped.packetScore);
+                av_frame_unref(skipped.frame);
+                ++m_dropped;
+            }
+            m_newest = m_fill;
+        }
+        m_newestCnd.notify_one();
+    }
+
+    /* detect stage: waits for newest frame, frame taken before is released
+     * nullptr: terminated */
+    StageFrame* take()
+    {
+        std::unique_lock<std::mutex> lock(m_mtx);
+        if (m_taken >= 0) {
+            av_frame_unref(m_slots[static_cast<size_t>(m_taken)].frame);
+            m_taken = -1;
+        }
+        m_newestCnd.wait(lock, [this] { return m_newest >= 0 || m_terminate; });
+        if (m_terminate)
+            return nullptr;
+        m_taken = m_newest;
+        m_newest = -1;
+        return &m_slots[static_cast<size_t>(m_taken)];
+    }
+
+    void terminate()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_terminate = true;
+        }
+        m_newestCnd.notify_one();
+    }
+
+private:
+    int                     m_dropped;
+    int                     m_fill;     // slot filled by decode stage
+    int                     m_newest;   // published, not taken yet, -1: none
+    int                     m_taken;    // analysed by detect stage, -1: none
+    std::mutex              m_mtx;
+    std::condition_variable m_newestCnd;
+    std::array<StageFrame, 3> m_slots;
+    bool                    m_terminate;
+    char                    avoidPaddingWarning1[7];
+};
+
+
+#endif // FRAMERING_H
@@ -1,17 +1,134 @@
 #include "motion-detector.h"
+#include "detection-kernels.h"
+
+#include <cstdio> // remove, rename
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/* file of saveState: header, background rows of rowBytes each (native byte order)
+ * fixed size types, no padding */
+struct StateFileHeader
+{
+    char        magic[4];       // "MDST"
+    uint32_t    version;
+    int64_t     savedAt;        // unix time, seconds
+    double      scaleFrame;
+    double      alpha;
+    double      bgrSubThreshold;
+    double      refEdges;
+    double      refRegions[16];
+    int32_t     engine;
+    int32_t     frameWidth;
+    int32_t     frameHeight;
+    int32_t     roi[4];         // x, y, width, height
+    int32_t     width;          // background
+    int32_t     height;
+    int32_t     type;
+    int32_t     rowBytes;
+    int32_t     motionDuration;
+    int32_t     idleCount;
+    int32_t     tamperCount;
+    int32_t     warmUpCount;
+    uint32_t    checksum;       // fnv-1a of background rows
+};
+static_assert(sizeof(StateFileHeader) == 240, "padding in StateFileHeader");
+
+static const char stateMagic[4] = {'M', 'D', 'S', 'T'};
+static const uint32_t stateVersion = 2; // 2: reference of regions and edges
+static const int32_t maxStateSide = 1 << 14; // pixels of background, bounds size arithmetic
+
+
+static uint32_t fnv1a(const uchar* data, size_t size, uint32_t hash = 2166136261u)
+{
+    for (size_t n = 0; n < size; ++n)
+        hash = (hash ^ data[n]) * 16777619u;
+    return hash;
+}
 
 
 // CLASS IMPLEMENTATION
 MotionDetector::MotionDetector() :
+    m_blobCount{0},
+    m_cascadeRefresh{25},       // frames
+    m_cascadeTail{25},          // frames
+    m_cascadeThreshold{0},      // cascade disabled
+    m_cellArea{16 * 16},
+    m_cellPixels{16},
+    m_coarseEngine{0.005, 8},
+    m_coarseSkipped{0},
+    m_coarseTail{0},
+    // default -> alpha: 0.005 threshold: 50
+    m_engine{createDetectorEngine(EngineType::lowPass, 0.005, 50)},
+    m_frameDuration{0},         // no time stamps
+    m_globalChangeArea{60},     // per cent
+    m_idleCount{0},
+    m_idleDelay{0},             // idle mode disabled
+    m_isCoarseOnly{false},
     m_isContinuousMotion{false},
+    m_isGlobalChange{false},
+    m_isMotion{false},
+    m_isTamper{false},
+    m_maxBlobCount{0},          // unlimited
+    m_minActiveCells{0},        // trigger by motion area
+    m_minBlobArea{0},           // blob filter disabled
+    m_minMotionArea{0.08},      // per cent, approx. 100 pixels of 480x270
     m_minMotionDuration{10},    // number of consecutive frames with motion
-    m_minMotionIntensity{100},  // number of pixels with motion
+    m_minMotionIntensity{0},    // pixels, depends on analysed area
     m_motionDuration{0},
-    m_roi{0,0,0,0}
+    m_motionInput{MotionInput::pixels},
+    m_mvThreshold{1.0},         // pixels
+    m_refEdges{-1},
+    m_refRegions{},
+    m_restoreState{},
+    m_roi{0,0,0,0},
+    m_scaleFrame{0.25},
+    m_seedCount{-1},            // not seeding
+    m_seedFrames{5},
+    m_suppressActivity{0},      // suppression disabled
+    m_suppressedCount{0},
+    m_suppressionTime{15000},   // frames, 10 min at 25 fps
+    m_tamperCount{0},
+    m_tamperDuration{0},        // tamper detection disabled
+    m_timeStamp{-1},
+    m_voteFrames{1},            // voting disabled
+    m_voteIndex{0},
+    m_voteMinimum{1},
+    m_warmUpCount{0},
+    m_warmUpFrames{50}
 {
-    // default -> alpha: 0.005 threshold: 50
-    m_bgrSub = createBackgroundSubtractorLowPass(0.005, 50);
+    // coarse stage: foreground count only
+    m_coarseEngine.stats().cellSize = 0;
+}
+
 
+// restored state: background and counters, if frame matches saved state, else seed
+void MotionDetector::applyState(cv::Size frameSize)
+{
+    DetectorState& state = m_restoreState;
+    bool isApplied = state.frameSize == frameSize && state.background.size() == m_processedFrame.size()
+            && std::visit([&state](auto& engine) { return engine.accumulator(state.background); }, m_engine);
+    if (isApplied) {
+        m_motionDuration = std::min(state.motionDuration, m_minMotionDuration);
+        m_idleCount = state.idleCount;
+        m_tamperCount = std::min(state.tamperCount, m_tamperDuration);
+        m_isTamper = m_tamperDuration > 0 && m_tamperCount >= m_tamperDuration;
+        m_warmUpCount = std::min(state.warmUpCount, m_warmUpFrames);
+        m_refEdges = state.refEdges;
+        m_refRegions = state.refRegions;
+        m_seedCount = -1;
+        m_coarseEngine.reset();
+    } else {
+        resetBackground();
+    }
+    state.background.release();
 }
 
 
@@ -20,45 +137,398 @@ void MotionDetector::bgrSubThreshold(double threshold)
     /* limit between 0 an 100 */
     threshold = threshold > 100 ? 100 : threshold;
     threshold = threshold < 0 ? 0 : threshold;
-    m_bgrSub->threshold(threshold);
+    std::visit([threshold](auto& engine) { engine.threshold(threshold); }, m_engine);
 }
 
 
 double MotionDetector::bgrSubThreshold() const
 {
-    return m_bgrSub->threshold();
+    return std::visit([](const auto& engine) { return engine.threshold(); }, m_engine);
 }
 
 
-bool MotionDetector::hasFrameMotion(cv::Mat frame)
+int MotionDetector::blobCount() const
 {
-    /* frame must be gray scale for this optimized version
-     * of background subtractor to work */
-    assert(frame.channels() == 1);
+    return m_blobCount;
+}
 
-    // use full frame size, if roi is not initialized yet
-    if (m_roi == cv::Rect(0,0,0,0))
-        m_roi = cv::Rect(cv::Point(0,0), frame.size());
 
-    // pre-processing of clipped frame
-    /* performance for pre-processing HD frame on RPi:
-     * blur10x10: 20ms      bgrSub: 25ms
-     * resize0.5:  2ms      bgrSub:  5ms
-     * */
+// connected components of active cells (of mask, if cells are disabled)
+// returns foreground pixels of blobs with at least minBlobArea, 0: more than maxBlobCount blobs
+int MotionDetector::blobMotion()
+{
+    int minBlobPixels = cvRound(m_resizedFrame.total() * m_minBlobArea / 100);
+    // motion vectors: count per macroblock
+    double countPixels = m_motionInput == MotionInput::vectors ? m_cellPixels * m_cellPixels : 1;
 
-    // intermediate step: resize full HD frame 1920x1080 -> 480x270
-    cv::resize(frame, m_resizedFrame, cv::Size(), 0.25, 0.25, cv::INTER_LINEAR);
-    // remove noise by blurring
-    int kernel = m_resizedFrame.size().width / 96;
-    if (kernel == 0) kernel = 2;
-    cv::blur(m_resizedFrame, m_processedFrame, cv::Size(kernel,kernel));
+    // cell grid: some hundred elements, labeling is negligible
+    bool isCells = !m_cellCounts.empty();
+    if (isCells) {
+        m_blobMap.create(m_cellCounts.size(), CV_8UC1);
+        for (int row = 0; row < m_cellCounts.rows; ++row) {
+            const int* count = m_cellCounts.ptr<int>(row);
+            uchar* active = m_blobMap.ptr<uchar>(row);
+            for (int col = 0; col < m_cellCounts.cols; ++col)
+                active[col] = isCellActive(count[col]) ? UCHAR_MAX : 0;
+        }
+    }
+    int nLabels = cv::connectedComponentsWithStats(isCells ? m_blobMap : m_motionMask,
+                                                   m_blobLabels, m_blobStats, m_blobCentroids, 8, CV_32S);
+
+    // foreground per blob: counts of its cells or its pixels
+    m_blobAreas.assign(static_cast<size_t>(nLabels), 0);
+    if (isCells) {
+        for (int row = 0; row < m_cellCounts.rows; ++row) {
+            const int* count = m_cellCounts.ptr<int>(row);
+            const int* label = m_blobLabels.ptr<int>(row);
+            for (int col = 0; col < m_cellCounts.cols; ++col)
+                m_blobAreas[static_cast<size_t>(label[col])] += count[col];
+        }
+    } else {
+        for (int n = 0; n < nLabels; ++n)
+            m_blobAreas[static_cast<size_t>(n)] = m_blobStats.at<int>(n, cv::CC_STAT_AREA);
+    }
+
+    // label 0: background
+    int intensity = 0;
+    m_blobCount = 0;
+    for (int n = 1; n < nLabels; ++n) {
+        int pixels = cvRound(m_blobAreas[static_cast<size_t>(n)] * countPixels);
+        if (pixels >= minBlobPixels) {
+            ++m_blobCount;
+            intensity += pixels;
+        }
+    }
+    if (m_maxBlobCount > 0 && m_blobCount > m_maxBlobCount)
+        return 0;
+    return intensity;
+}
+
+
+void MotionDetector::cascadeRefresh(int frames)
+{
+    m_cascadeRefresh = frames < 1 ? 1 : frames;
+}
+
+
+int MotionDetector::cascadeRefresh() const
+{
+    return m_cascadeRefresh;
+}
+
+
+void MotionDetector::cascadeTail(int frames)
+{
+    m_cascadeTail = frames < 0 ? 0 : frames;
+}
+
+
+int MotionDetector::cascadeTail() const
+{
+    return m_cascadeTail;
+}
+
+
+void MotionDetector::cascadeThreshold(double threshold)
+{
+    m_cascadeThreshold = threshold > 0 ? threshold : 0;
+    m_coarseEngine.threshold(m_cascadeThreshold);
+}
+
+
+double MotionDetector::cascadeThreshold() const
+{
+    return m_cascadeThreshold;
+}
+
+
+/* coarse stage of cascade: roi downscaled by 4 x scaleFrame (block means, no blur),
+ * segmented against own low pass background at alpha of engine
+ * true: fine stage needed (block changed, tail, refresh, first frame, background restart) */
+bool MotionDetector::coarseMotion(const cv::Mat& frame, int frameStep)
+{
+    cv::Rect roi = frameRoi(frame.size(), 1);
+    int factor = cvRound(4 / m_scaleFrame);
+    if (std::abs(factor * m_scaleFrame - 4) < 1e-9 && factor <= 16) {
+        poolBlur(frame.ptr<uchar>(roi.y) + roi.x, frame.step, roi.size(), factor, 0,
+                 m_coarsePooled, m_coarseFrame, SimdPath::best);
+    } else {
+        cv::resize(frame(roi), m_coarseFrame, cv::Size(), m_scaleFrame / 4, m_scaleFrame / 4, cv::INTER_AREA);
+    }
+
+    // first frame, frame of other size (roi, scale) or reset with fine stage (seed, restore):
+    // coarse background restarts
+    bool isRestart = m_coarseEngine.accumulator().empty() || m_coarseMask.size() != m_coarseFrame.size();
+    double alpha = std::visit([](const auto& engine) { return engine.alpha(); }, m_engine);
+    double learningRate = 1 - std::pow(1 - alpha, std::max(frameStep, 1));
+    int count = m_coarseEngine.apply(m_coarseFrame, m_coarseMask, learningRate);
+
+    // as fine stage: foreground in zones and outside of suppressed cells only
+    // coarse pixel mapped to its center in analysed frame of last fine stage
+    const bool hasZones = !m_zoneLabels.empty() && m_zoneLabels.size() == m_processedFrame.size();
+    const int cellSize = engineStats().cellSize;
+    const bool hasSuppression = m_suppressedCount > 0 && cellSize > 0 && !m_suppressedCells.empty();
+    if (count > 0 && !isRestart && (hasZones || hasSuppression)) {
+        const int rows = m_processedFrame.rows;
+        const int cols = m_processedFrame.cols;
+        count = 0;
+        for (int row = 0; row < m_coarseMask.rows; ++row) {
+            const uchar* fg = m_coarseMask.ptr<uchar>(row);
+            int y = std::min((2 * row + 1) * rows / (2 * m_coarseMask.rows), rows - 1);
+            const uchar* label = hasZones ? m_zoneLabels.ptr<uchar>(y) : nullptr;
+            const uchar* suppressed = hasSuppression
+                    ? m_suppressedCells.ptr<uchar>(std::min(y / cellSize, m_suppressedCells.rows - 1)) : nullptr;
+            for (int col = 0; col < m_coarseMask.cols; ++col) {
+                if (!fg[col])
+                    continue;
+                int x = std::min((2 * col + 1) * cols / (2 * m_coarseMask.cols), cols - 1);
+                if ((label && !label[x])
+                        || (suppressed && suppressed[std::min(x / cellSize, m_suppressedCells.cols - 1)]))
+                    continue;
+                ++count;
+            }
+        }
+    }
+
+    if (count > 0)
+        m_coarseTail = m_cascadeTail;
+    else
+        m_coarseTail = std::max(m_coarseTail - std::max(frameStep, 1), 0);
+    return isRestart || count > 0 || m_coarseTail > 0
+            || m_coarseSkipped + std::max(frameStep, 1) >= m_cascadeRefresh
+            || m_seedCount >= 0 || !m_restoreState.background.empty();
+}
+
+
+void MotionDetector::engine(EngineType type)
+{
+    if (type == engineType(m_engine))
+        return;
+    SegmentStats& stats = engineStats();
+    DetectorEngine engine = std::visit([type](const auto& current) {
+        return createDetectorEngine(type, current.alpha(), current.threshold());
+    }, m_engine);
+    // cells and zone maps of current engine
+    std::visit([&stats](auto& next) {
+        next.stats().cellSize = stats.cellSize;
+        next.stats().labels = stats.labels;
+        next.stats().thresholds = stats.thresholds;
+        next.stats().skipCells = stats.skipCells;
+    }, engine);
+    m_engine = std::move(engine);
+    m_warmUpCount = 0;
+}
+
+
+EngineType MotionDetector::engine() const
+{
+    return engineType(m_engine);
+}
+
+
+SegmentStats& MotionDetector::engineStats()
+{
+    return std::visit([](auto& engine) -> SegmentStats& { return engine.stats(); }, m_engine);
+}
+
+
+// cells with motion, counting stops at limit
+int MotionDetector::countActiveCells(int limit) const
+{
+    int active = 0;
+    for (int row = 0; row < m_cellCounts.rows; ++row) {
+        const int* count = m_cellCounts.ptr<int>(row);
+        for (int col = 0; col < m_cellCounts.cols; ++col) {
+            if (isCellActive(count[col]) && ++active >= limit)
+                return active;
+        }
+    }
+    return active;
+}
+
+
+// roi clipped to frame, in units of cellSize pixels (16: macroblocks)
+// cells partly covered by roi are included, empty roi: full frame
+cv::Rect MotionDetector::frameRoi(cv::Size frameSize, int cellSize) const
+{
+    cv::Rect frameRect(cv::Point(0,0), frameSize);
+    cv::Point tl(m_roi.x / cellSize, m_roi.y / cellSize);
+    cv::Point br((m_roi.x + m_roi.width + cellSize - 1) / cellSize,
+                 (m_roi.y + m_roi.height + cellSize - 1) / cellSize);
+    cv::Rect roi = cv::Rect(tl, br) & frameRect;
+    return roi.area() > 0 ? roi : frameRect;
+}
+
+
+void MotionDetector::frameDuration(double seconds)
+{
+    m_frameDuration = seconds > 0 ? seconds : 0;
+}
+
+
+double MotionDetector::frameDuration() const
+{
+    return m_frameDuration;
+}
+
+
+/* statistics of analysed frame: mean luminance of 4x4 regions, edge energy (mean gradient)
+ * global change: whole-frame foreground and luminance shifted uniformly against reference,
+ * median region shift of more than 8 gray levels and 12 of 16 regions within half of it
+ * (object close to camera: regions outside of it keep their luminance)
+ * reference learns at background rate, restarts with global change
+ * tamper: whole-frame foreground or texture lost (edge energy below a quarter of reference:
+ * covered, defocused), reference of edges not learned meanwhile
+ * low contrast scenes (night, fog) are learned as reference, not uniform by themselves */
+bool MotionDetector::globalChange(int foregroundCount, int frames)
+{
+    const int cols = m_processedFrame.cols;
+    const int rows = m_processedFrame.rows;
+    if (cols < 4 || rows < 4)
+        return false;
+    std::array<double, 16> regions{};
+    std::array<int, 16> pixels{};
+    int64_t edges = 0;
+    for (int row = 0; row < rows; ++row) {
+        const uchar* src = m_processedFrame.ptr<uchar>(row);
+        const uchar* below = m_processedFrame.ptr<uchar>(row + 1 < rows ? row + 1 : row);
+        size_t region = static_cast<size_t>(row * 4 / rows) * 4;
+        for (int part = 0; part < 4; ++part, ++region) {
+            int first = cols * part / 4;
+            int last = cols * (part + 1) / 4;
+            int64_t sum = 0;
+            for (int x = first; x < last; ++x) {
+                int right = x + 1 < cols ? src[x + 1] : src[x];
+                edges += std::abs(right - src[x]) + std::abs(below[x] - src[x]);
+                sum += src[x];
+            }
+            regions[region] += static_cast<double>(sum);
+            pixels[region] += last - first;
+        }
+    }
+    for (size_t region = 0; region < regions.size(); ++region)
+        regions[region] /= pixels[region];
+    double total = static_cast<double>(m_processedFrame.total());
+    double edgeEnergy = edges / total;
+    bool isUniform = m_refEdges > 0 && edgeEnergy < 0.25 * m_refEdges;
+
+    // analysed area: pixels of zones, if set
+    double area = total;
+    if (!m_zones.empty()) {
+        area = 0;
+        for (const MotionZone& zone : m_zones)
+            area += zone.area;
+    }
+    bool isWholeFrame = m_globalChangeArea > 0 && area > 0
+            && foregroundCount * 100.0 > m_globalChangeArea * area;
+    bool isChange = false;
+    // lost texture is not learned as new background, but counts as tamper
+    if (isWholeFrame && m_refEdges >= 0 && !isUniform) {
+        std::array<double, 16> shifts;
+        for (size_t region = 0; region < regions.size(); ++region)
+            shifts[region] = regions[region] - m_refRegions[region];
+        std::array<double, 16> sorted = shifts;
+        std::nth_element(sorted.begin(), sorted.begin() + 8, sorted.end());
+        double median = sorted[8];
+        double tolerance = std::max(std::abs(median) / 2, 8.0);
+        long similar = std::count_if(shifts.begin(), shifts.end(),
+                                     [=](double shift) { return std::abs(shift - median) <= tolerance; });
+        isChange = std::abs(median) > 8 && similar >= 12;
+    }
+
+    double rate = std::visit([](const auto& engine) { return engine.alpha(); }, m_engine);
+    rate = isChange || m_refEdges < 0 ? 1 : 1 - std::pow(1 - rate, std::max(frames, 1));
+    for (size_t region = 0; region < regions.size(); ++region)
+        m_refRegions[region] += rate * (regions[region] - m_refRegions[region]);
+    if (!isUniform)
+        m_refEdges += rate * (edgeEnergy - m_refEdges);
 
-    // detect motion in current frame
-    //m_bgrSub->apply(m_resizedFrame, m_motionMask);
-    m_bgrSub->apply(m_processedFrame, m_motionMask);
+    if (m_tamperDuration > 0) {
+        if (isWholeFrame || isUniform)
+            m_tamperCount = std::min(m_tamperCount + frames, m_tamperDuration);
+        else
+            m_tamperCount = std::max(m_tamperCount - frames, 0);
+        if (m_tamperCount >= m_tamperDuration)
+            m_isTamper = true;
+        else if (m_tamperCount == 0)
+            m_isTamper = false;
+    }
+    return isChange;
+}
+
+
+void MotionDetector::globalChangeArea(double percent)
+{
+    /* limit between 0 (disabled) and 100 */
+    percent = percent > 100 ? 100 : percent;
+    percent = percent < 0 ? 0 : percent;
+    m_globalChangeArea = percent;
+}
+
+
+double MotionDetector::globalChangeArea() const
+{
+    return m_globalChangeArea;
+}
+
+
+// frames since last update step, measured by time stamps
+// 1: no time stamps, first frame or time stamp not increasing (stream restarted)
+int MotionDetector::elapsedFrames(double timeStamp)
+{
+    int frames = 1;
+    if (m_frameDuration > 0 && timeStamp >= 0 && m_timeStamp >= 0 && timeStamp > m_timeStamp) {
+        // limit: gap of one day at 100 fps
+        double elapsed = std::min((timeStamp - m_timeStamp) / m_frameDuration, 1e7);
+        frames = std::max(cvRound(elapsed), 1);
+    }
+    m_timeStamp = timeStamp;
+    return frames;
+}
+
+
+bool MotionDetector::hasFrameMotion(cv::Mat frame, int frameStep, double timeStamp)
+{
+    // time stamps: frames dropped before decoding count, too
+    int frames = elapsedFrames(timeStamp);
+    if (m_frameDuration > 0 && timeStamp >= 0)
+        frameStep = frames;
 
-    m_motionIntensity = cv::countNonZero(m_motionMask);
-    bool isMotion = m_motionIntensity > m_minMotionIntensity ? true : false;
+    // cascade: coarse stage only for static frames, fine stage learns skipped frames at once
+    m_isCoarseOnly = m_motionInput == MotionInput::pixels && m_cascadeThreshold > 0
+            && !coarseMotion(frame, frameStep);
+    if (m_isCoarseOnly) {
+        m_coarseSkipped += std::max(frameStep, 1);
+        m_motionIntensity = 0;
+        m_blobCount = 0;
+        m_isGlobalChange = false;
+        m_cellCounts.setTo(cv::Scalar(0));
+        std::fill(m_zoneCounts.begin(), m_zoneCounts.end(), 0);
+    } else if (m_motionInput == MotionInput::vectors) {
+        m_motionIntensity = vectorMotion(frame);
+    } else {
+        m_motionIntensity = pixelMotion(frame, frameStep + m_coarseSkipped);
+        m_coarseSkipped = 0;
+    }
+    // flicker suppression: intensity, cells and zones of voted mask
+    if (m_voteFrames > 1 && !m_isCoarseOnly) {
+        double bitPixels = m_motionInput == MotionInput::vectors ? m_cellPixels * m_cellPixels : 1;
+        m_motionIntensity = cvRound(voteMotion() * bitPixels);
+    }
+    // small scattered blobs (rain, insects, compression noise) do not count
+    if (m_minBlobArea > 0 && !m_isCoarseOnly) {
+        m_motionIntensity = blobMotion();
+    }
+    // resized frame: analysed area of both inputs (roi after scaling)
+    m_minMotionIntensity = cvRound(m_resizedFrame.total() * m_minMotionArea / 100);
+    bool isMotion = false;
+    if (!m_zones.empty()) {
+        isMotion = updateZones(m_zoneCounts, frames);
+    } else if (m_minActiveCells > 0) {
+        isMotion = countActiveCells(m_minActiveCells) >= m_minActiveCells;
+    } else {
+        isMotion = m_motionIntensity > m_minMotionIntensity;
+    }
 
     // DEBUG
     /*
@@ -81,28 +551,79 @@ bool MotionDetector::hasFrameMotion(cv::Mat frame)
     // DEBUG_END
 
     // update motion duration
-    // motion increase by 1
+    // motion increase by frames since last update, if there was motion at last update,
+    // else by 1: motion is not assumed for frames skipped before it was detected
     if (isMotion) {
-        ++m_motionDuration;
+        m_motionDuration += m_isMotion ? frames : 1;
         m_motionDuration = m_motionDuration > m_minMotionDuration
                 ? m_minMotionDuration : m_motionDuration;
 
-    // no motion decrease by 1
+    // no motion decrease by frames since last update
     } else {
-        --m_motionDuration;
+        m_motionDuration -= frames;
         m_motionDuration = m_motionDuration <= 0
                 ? 0 : m_motionDuration;
     }
+    m_isMotion = isMotion;
+
+    // idle mode: one update step per key frame
+    // wake up before motion duration starts counting, in order to keep
+    // minMotionDuration valid as number of (full frame rate) frames
+    if (isIdle()) {
+        int wakeCells = (m_minActiveCells + 1) / 2;
+        bool isWake = isMotion;
+        if (m_zones.empty()) {
+            isWake = m_minActiveCells > 0
+                    ? countActiveCells(wakeCells) >= wakeCells
+                    : m_motionIntensity > m_minMotionIntensity / 2;
+        }
+        if (isWake)
+            m_idleCount = 0;
+    } else if (m_motionDuration == 0 && !isMotion) {
+        ++m_idleCount;
+    } else {
+        m_idleCount = 0;
+    }
 
     return isMotion;
 }
 
 
-bool MotionDetector::isContinuousMotion(cv::Mat frame)
+void MotionDetector::idleDelay(int value)
 {
-    hasFrameMotion(frame);
+    m_idleDelay = value < 0 ? 0 : value;
+}
+
+
+int MotionDetector::idleDelay() const
+{
+    return m_idleDelay;
+}
+
+
+// more than 1/8 of cell area is foreground
+bool MotionDetector::isCellActive(int count) const
+{
+    return count * 8 > m_cellArea;
+}
+
+
+bool MotionDetector::isCoarseOnly() const
+{
+    return m_isCoarseOnly;
+}
+
 
-    if (m_motionDuration >= m_minMotionDuration) {
+bool MotionDetector::isContinuousMotion(cv::Mat frame, int frameStep, double timeStamp)
+{
+    hasFrameMotion(frame, frameStep, timeStamp);
+
+    if (!m_zones.empty()) {
+        // each zone with own duration
+        m_isContinuousMotion = false;
+        for (const MotionZone& zone : m_zones)
+            m_isContinuousMotion = m_isContinuousMotion || zone.isContinuousMotion;
+    } else if (m_motionDuration >= m_minMotionDuration) {
         m_isContinuousMotion = true;
     } else if (m_motionDuration == 0) {
         m_isContinuousMotion = false;
@@ -112,6 +633,78 @@ bool MotionDetector::isContinuousMotion(cv::Mat frame)
 }
 
 
+bool MotionDetector::isGlobalChange() const
+{
+    return m_isGlobalChange;
+}
+
+
+bool MotionDetector::isIdle() const
+{
+    return m_idleDelay > 0 && m_idleCount >= m_idleDelay;
+}
+
+
+bool MotionDetector::isTamper() const
+{
+    return m_isTamper;
+}
+
+
+void MotionDetector::maxBlobCount(int value)
+{
+    m_maxBlobCount = value < 0 ? 0 : value;
+}
+
+
+int MotionDetector::maxBlobCount() const
+{
+    return m_maxBlobCount;
+}
+
+
+void MotionDetector::minActiveCells(int value)
+{
+    m_minActiveCells = value < 0 ? 0 : value;
+}
+
+
+int MotionDetector::minActiveCells() const
+{
+    return m_minActiveCells;
+}
+
+
+void MotionDetector::minBlobArea(double percent)
+{
+    /* limit between 0 and 100 per cent */
+    percent = percent > 100 ? 100 : percent;
+    percent = percent < 0 ? 0 : percent;
+    m_minBlobArea = percent;
+}
+
+
+double MotionDetector::minBlobArea() const
+{
+    return m_minBlobArea;
+}
+
+
+void MotionDetector::minMotionArea(double percent)
+{
+    /* limit between 0 and 100 per cent */
+    percent = percent > 100 ? 100 : percent;
+    percent = percent < 0 ? 0 : percent;
+    m_minMotionArea = percent;
+}
+
+
+double MotionDetector::minMotionArea() const
+{
+    return m_minMotionArea;
+}
+
+
 void MotionDetector::minMotionDuration(int value)
 {
     /* allow 300 update steps at max */
@@ -127,16 +720,6 @@ int MotionDetector::minMotionDuration() const
 }
 
 
-void MotionDetector::minMotionIntensity(int value)
-{
-    //* per cent of frame area */
-    //value = value > 100 ? 100 : value;
-    // value = value < 0 ? 0 : value;
-    /* number of pixels */
-    m_minMotionIntensity = value;
-}
-
-
 int MotionDetector::minMotionIntensity() const
 {
     return m_minMotionIntensity;
@@ -149,6 +732,43 @@ int MotionDetector::motionDuration() const
 }
 
 
+cv::Rect MotionDetector::motionBox() const
+{
+    cv::Point tl(m_cellCounts.cols, m_cellCounts.rows);
+    cv::Point br(-1, -1);
+    for (int row = 0; row < m_cellCounts.rows; ++row) {
+        const int* count = m_cellCounts.ptr<int>(row);
+        for (int col = 0; col < m_cellCounts.cols; ++col) {
+            if (isCellActive(count[col])) {
+                tl = cv::Point(std::min(tl.x, col), std::min(tl.y, row));
+                br = cv::Point(std::max(br.x, col), std::max(br.y, row));
+            }
+        }
+    }
+    if (br.x < 0)
+        return cv::Rect();
+
+    // cells -> pixels of resized frame
+    cv::Rect box(cvRound(tl.x * m_cellPixels), cvRound(tl.y * m_cellPixels),
+                 cvRound((br.x - tl.x + 1) * m_cellPixels), cvRound((br.y - tl.y + 1) * m_cellPixels));
+    return box & cv::Rect(cv::Point(0,0), m_resizedFrame.size());
+}
+
+
+cv::Mat MotionDetector::motionCells() const
+{
+    cv::Mat cells;
+    motionCells(cells);
+    return cells;
+}
+
+
+void MotionDetector::motionCells(cv::Mat& cells) const
+{
+    m_cellCounts.convertTo(cells, CV_8U, static_cast<double>(UCHAR_MAX) / m_cellArea);
+}
+
+
 int MotionDetector::motionIntensity() const
 {
     return m_motionIntensity;
@@ -161,12 +781,229 @@ cv::Mat MotionDetector::motionMask() const
 }
 
 
+void MotionDetector::motionInput(MotionInput input)
+{
+    m_motionInput = input;
+}
+
+
+MotionInput MotionDetector::motionInput() const
+{
+    return m_motionInput;
+}
+
+
+void MotionDetector::mvThreshold(double value)
+{
+    m_mvThreshold = value < 0 ? 0 : value;
+}
+
+
+double MotionDetector::mvThreshold() const
+{
+    return m_mvThreshold;
+}
+
+
+int MotionDetector::pixelMotion(cv::Mat frame, int frameStep)
+{
+    /* frame must be gray scale for this optimized version
+     * of background subtractor to work */
+    assert(frame.channels() == 1);
+
+    // pre-processing of clipped frame
+    /* performance for pre-processing HD frame on RPi:
+     * blur10x10: 20ms      bgrSub: 25ms
+     * resize0.5:  2ms      bgrSub:  5ms
+     * */
+
+    // crop first: pixels outside roi are neither scaled, filtered nor segmented
+    m_frameSize = frame.size();
+    cv::Rect roi = frameRoi(frame.size(), 1);
+
+    // intermediate step: downscale cropped frame, e.g. full HD 1920x1080 -> 480x270
+    // and remove noise by blurring
+    int factor = cvRound(1 / m_scaleFrame);
+    int kernel = cvRound(roi.width * m_scaleFrame) / 96;
+    if (kernel == 0) kernel = 2;
+    if (std::abs(factor * m_scaleFrame - 1) < 1e-9) {
+        // integer factor: area downscale (no aliasing) and blur in one sweep over plane
+        // serial: kernel specialised for geometry of camera fleet, if full frame matches
+        const uchar* src = frame.ptr<uchar>(roi.y) + roi.x;
+        if (m_workers || !poolBlurFixed(src, frame.step, roi.size(), factor, kernel, m_resizedFrame, m_processedFrame))
+            poolBlur(src, frame.step, roi.size(), factor, kernel,
+                     m_resizedFrame, m_processedFrame, SimdPath::best, m_workers.get());
+    } else {
+        cv::resize(frame(roi), m_resizedFrame, cv::Size(), m_scaleFrame, m_scaleFrame, cv::INTER_LINEAR);
+        cv::blur(m_resizedFrame, m_processedFrame, cv::Size(kernel,kernel));
+    }
+
+    // zones: label and threshold map in size of analysed frame, rasterized once
+    if (!m_zones.empty() && m_zoneLabels.size() != m_processedFrame.size()) {
+        rasterizeZones(m_processedFrame.size(), cv::Point2d(roi.x, roi.y), m_scaleFrame);
+        engineStats().labels = m_zoneLabels;
+        engineStats().thresholds = m_zoneThresholds;
+    }
+
+    // background restarts with frame of other size (roi, scale)
+    if (m_motionMask.size() != m_processedFrame.size())
+        m_warmUpCount = 0;
+    if (!m_restoreState.background.empty())
+        applyState(frame.size());
+    if (m_seedCount >= 0)
+        seedBackground();
+
+    // detect motion in current frame, one dispatch per frame:
+    // apply of each engine is resolved at compile time, calls its model's kernel directly
+    // warm-up: alpha decays from 1/2 in log scale
+    // skipped frames: alpha for n steps -> 1 - (1 - alpha)^n
+    int foregroundCount = std::visit([&](auto& engine) {
+        double alpha = engine.alpha();
+        if (m_warmUpCount < m_warmUpFrames && alpha < 0.5)
+            alpha = 0.5 * std::pow(alpha / 0.5, static_cast<double>(m_warmUpCount) / m_warmUpFrames);
+        double learningRate = -1;
+        if (frameStep > 1 || alpha != engine.alpha())
+            learningRate = 1 - std::pow(1 - alpha, std::max(frameStep, 1));
+        return engine.apply(m_processedFrame, m_motionMask, learningRate, m_workers.get());
+    }, m_engine);
+    m_warmUpCount = std::min(m_warmUpCount + std::max(frameStep, 1), m_warmUpFrames);
+
+    // global change: restart background with current frame instead of motion
+    m_isGlobalChange = globalChange(foregroundCount, std::max(frameStep, 1));
+    if (m_isGlobalChange) {
+        foregroundCount = std::visit([&](auto& engine) {
+            engine.reset();
+            return engine.apply(m_processedFrame, m_motionMask, -1, m_workers.get());
+        }, m_engine);
+        m_warmUpCount = 0;
+        // coarse stage: background of same frame, else relit scene keeps waking fine stage
+        if (!m_coarseFrame.empty())
+            m_coarseEngine.seed(m_coarseFrame);
+    }
+
+    // foreground per cell, counted by segmentation engine
+    const SegmentStats& stats = engineStats();
+    m_cellCounts = stats.cells;
+    m_cellArea = stats.cellSize * stats.cellSize;
+    m_cellPixels = stats.cellSize;
+    m_zoneCounts = stats.zoneCounts;
+
+    // long-term activity: not while background restarts (seed, global change)
+    if (m_seedCount < 0 && !m_isGlobalChange)
+        updateSuppression(std::max(frameStep, 1));
+
+    return foregroundCount;
+}
+
+
+cv::Mat MotionDetector::packedMask() const
+{
+    return m_votedMask;
+}
+
+
 cv::Mat MotionDetector::processedFrame() const
 {
     return m_processedFrame;
 }
 
 
+// polygons -> label map (zone index + 1) and threshold map (outside of zones: never foreground)
+// offset: upper left corner of analysed region, scale: analysed frame / frame
+void MotionDetector::rasterizeZones(cv::Size size, cv::Point2d offset, double scale)
+{
+    m_zoneLabels.create(size, CV_8UC1);
+    m_zoneLabels.setTo(cv::Scalar(0));
+    m_zoneThresholds.create(size, CV_8UC1);
+    m_zoneThresholds.setTo(cv::Scalar(UCHAR_MAX));
+
+    // label 0: outside of zones
+    size_t nZones = std::min(m_zones.size(), static_cast<size_t>(UCHAR_MAX));
+    for (size_t n = 0; n < nZones; ++n) {
+        std::vector<std::vector<cv::Point>> polygons(1);
+        for (const cv::Point& point : m_zones[n].polygon) {
+            polygons[0].push_back(cv::Point(cvRound((point.x - offset.x) * scale),
+                                            cvRound((point.y - offset.y) * scale)));
+        }
+        cv::fillPoly(m_zoneLabels, polygons, cv::Scalar(static_cast<double>(n + 1)));
+    }
+    m_zoneMasks.resize(nZones);
+    for (size_t n = 0; n < nZones; ++n) {
+        cv::Mat zoneMask = m_zoneLabels == static_cast<double>(n + 1);
+        m_zones[n].area = cv::countNonZero(zoneMask);
+        m_zoneThresholds.setTo(cv::Scalar(cvFloor(m_zones[n].bgrSubThreshold)), zoneMask);
+        packMask(zoneMask, m_zoneMasks[n]);
+    }
+}
+
+
+void MotionDetector::resetBackground()
+{
+    m_coarseEngine.reset();
+    m_seedCount = 0;
+    m_warmUpCount = 0;
+}
+
+
+bool MotionDetector::restoreState(const std::string& path, int maxAge)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(StateFileHeader)) {
+        ::close(fd);
+        return false;
+    }
+    size_t fileSize = static_cast<size_t>(info.st_size);
+    void* map = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    StateFileHeader header;
+    std::memcpy(&header, map, sizeof(header));
+    const uchar* rows = static_cast<const uchar*>(map) + sizeof(header);
+    int64_t age = static_cast<int64_t>(std::time(nullptr)) - header.savedAt;
+    EngineType engineSaved = static_cast<EngineType>(header.engine);
+    cv::Rect roi(header.roi[0], header.roi[1], header.roi[2], header.roi[3]);
+    bool isValid = std::memcmp(header.magic, stateMagic, sizeof(stateMagic)) == 0
+            && header.version == stateVersion
+            && (header.type == CV_8UC1 || header.type == CV_16UC1 || header.type == CV_32FC1)
+            && header.width > 0 && header.height > 0
+            && header.width <= maxStateSide && header.height <= maxStateSide
+            && static_cast<int64_t>(header.rowBytes)
+               == static_cast<int64_t>(header.width) * static_cast<int64_t>(CV_ELEM_SIZE(header.type))
+            && static_cast<uint64_t>(fileSize) == sizeof(header)
+               + static_cast<uint64_t>(header.height) * static_cast<uint64_t>(header.rowBytes)
+            && age >= 0 && age <= maxAge
+            && engineSaved == engine() && roi == m_roi && std::abs(header.scaleFrame - m_scaleFrame) < 1e-9
+            && fnv1a(rows, fileSize - sizeof(header)) == header.checksum;
+    if (isValid) {
+        // mapped rows as matrix, copied before unmapping
+        const cv::Mat background(header.height, header.width, header.type, const_cast<uchar*>(rows),
+                                 static_cast<size_t>(header.rowBytes));
+        DetectorState& state = m_restoreState;
+        background.copyTo(state.background);
+        state.frameSize = cv::Size(header.frameWidth, header.frameHeight);
+        state.roi = roi;
+        state.scaleFrame = header.scaleFrame;
+        state.alpha = header.alpha;
+        state.bgrSubThreshold = header.bgrSubThreshold;
+        state.engine = engineSaved;
+        state.motionDuration = header.motionDuration;
+        state.idleCount = header.idleCount;
+        state.tamperCount = header.tamperCount;
+        state.warmUpCount = header.warmUpCount;
+        state.refEdges = header.refEdges;
+        std::copy(header.refRegions, header.refRegions + 16, state.refRegions.begin());
+        m_seedCount = -1;
+    }
+    munmap(map, fileSize);
+    return isValid;
+}
+
+
 cv::Mat MotionDetector::resizedFrame() const
 {
     return m_resizedFrame;
@@ -179,42 +1016,500 @@ void MotionDetector::roi(cv::Rect value)
 }
 
 
-cv::Rect MotionDetector::roi() constdx -> reverse index of circul            // preIdx -> reverse index of circular buffer (head = oldest index)
-            int preIdx = - static_cast<int>((diagBuf.size() - 1) - (n * idxSteps));
-            // std::cout << "pre idx: " << preIdx << std::endl;
-            diagBuf.at(idxRingBuf).preIdx = preIdx;
+cv::Rect MotionDetector::roi() const
+{
+    return m_roi;
+}
+
+
+void MotionDetector::scaleFrame(double value)
+{
+    /* limit between 1/16 and 1 (no scaling) */
+    value = value > 1 ? 1 : value;
+    value = value < 0.0625 ? 0.0625 : value;
+    m_scaleFrame = value;
+}
+
+
+double MotionDetector::scaleFrame() const
+{
+    return m_scaleFrame;
+}
+
+
+void MotionDetector::tamperDuration(int frames)
+{
+    m_tamperDuration = frames < 0 ? 0 : frames;
+    m_tamperCount = std::min(m_tamperCount, m_tamperDuration);
+    m_isTamper = m_isTamper && m_tamperDuration > 0;
+}
+
+
+int MotionDetector::tamperDuration() const
+{
+    return m_tamperDuration;
+}
+
+
+void MotionDetector::threads(int value)
+{
+    /* limit between 1 and 16, pool is kept while number is unchanged */
+    value = value > 16 ? 16 : value;
+    value = value < 1 ? 1 : value;
+    if (value == threads())
+        return;
+    if (value == 1)
+        m_workers.reset();
+    else
+        m_workers.reset(new WorkerPool(value));
+}
+
+
+int MotionDetector::threads() const
+{
+    return m_workers ? m_workers->size() : 1;
+}
+
+
+bool MotionDetector::saveState(const std::string& path) const
+{
+    cv::Mat background = std::visit([](const auto& engine) { return engine.accumulator(); }, m_engine);
+    if (background.empty() || m_motionInput != MotionInput::pixels)
+        return false;
+
+    StateFileHeader header{};
+    std::memcpy(header.magic, stateMagic, sizeof(stateMagic));
+    header.version = stateVersion;
+    header.savedAt = static_cast<int64_t>(std::time(nullptr));
+    header.scaleFrame = m_scaleFrame;
+    header.alpha = std::visit([](const auto& engine) { return engine.alpha(); }, m_engine);
+    header.bgrSubThreshold = bgrSubThreshold();
+    header.refEdges = m_refEdges;
+    std::copy(m_refRegions.begin(), m_refRegions.end(), header.refRegions);
+    header.engine = static_cast<int32_t>(engine());
+    header.frameWidth = m_frameSize.width;
+    header.frameHeight = m_frameSize.height;
+    header.roi[0] = m_roi.x;
+    header.roi[1] = m_roi.y;
+    header.roi[2] = m_roi.width;
+    header.roi[3] = m_roi.height;
+    header.width = background.cols;
+    header.height = background.rows;
+    header.type = background.type();
+    header.rowBytes = static_cast<int32_t>(background.elemSize() * static_cast<size_t>(background.cols));
+    header.motionDuration = m_motionDuration;
+    header.idleCount = m_idleCount;
+    header.tamperCount = m_tamperCount;
+    header.warmUpCount = m_warmUpCount;
+    header.checksum = 2166136261u;
+    for (int row = 0; row < background.rows; ++row)
+        header.checksum = fnv1a(background.ptr<uchar>(row), static_cast<size_t>(header.rowBytes), header.checksum);
+
+    // temporary file renamed: previous state stays valid, if writing fails
+    // closed and checked (buffered data may fail on close, e.g. disk full), synced to disk
+    // before rename: no truncated state file after restart or power loss
+    std::string tmpPath = path + ".tmp";
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (int row = 0; row < background.rows; ++row)
+        file.write(background.ptr<char>(row), header.rowBytes);
+    file.close();
+    bool isWritten = !file.fail();
+    if (isWritten) {
+        int fd = ::open(tmpPath.c_str(), O_RDONLY);
+        isWritten = fd >= 0 && fsync(fd) == 0;
+        if (fd >= 0)
+            ::close(fd);
+    }
+    if (!isWritten || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+/* analysed frame added to seed buffer, background restarts with it (no foreground)
+ * buffer complete: background from median, next segmentation against it
+ * frame of other size restarts seed */
+void MotionDetector::seedBackground()
+{
+    m_seedBuffer.resize(static_cast<size_t>(m_seedFrames));
+    if (m_seedCount > 0 && m_seedBuffer[0].size() != m_processedFrame.size())
+        m_seedCount = 0;
+    m_processedFrame.copyTo(m_seedBuffer[static_cast<size_t>(m_seedCount)]);
+    ++m_seedCount;
+    if (m_seedCount < m_seedFrames) {
+        std::visit([](auto& engine) { engine.reset(); }, m_engine);
+        return;
+    }
+    cv::Mat median;
+    medianFrames(m_seedBuffer, median);
+    std::visit([&median](auto& engine) { engine.seed(median); }, m_engine);
+    m_seedCount = -1;
+    // seed counts as learned frames
+    m_warmUpCount = std::min(m_seedFrames, m_warmUpFrames);
+}
+
+
+void MotionDetector::seedFrames(int frames)
+{
+    /* limit between 1 (current frame) and 15 */
+    frames = frames > 15 ? 15 : frames;
+    frames = frames < 1 ? 1 : frames;
+    m_seedFrames = frames;
+    m_seedCount = std::min(m_seedCount, m_seedFrames - 1);
+}
+
+
+int MotionDetector::seedFrames() const
+{
+    return m_seedFrames;
+}
 
-            printDetectionParams(diagBuf.at(idxRingBuf));
-            diagPicBuffer.push_back(diagBuf.at(idxRingBuf));
+
+bool MotionDetector::saveSuppressionMask(const std::string& path) const
+{
+    if (m_activityMap.empty() || m_resizedFrame.empty() || m_resizedFrame.type() != CV_8UC1)
+        return false;
+    cv::Mat image;
+    cv::cvtColor(m_resizedFrame, image, cv::COLOR_GRAY2BGR);
+    const int cellSize = cvRound(m_cellPixels);
+    const cv::Rect frameRect(cv::Point(0, 0), image.size());
+    for (int row = 0; row < m_activityMap.rows; ++row) {
+        const float* activity = m_activityMap.ptr<float>(row);
+        const uchar* suppressed = m_suppressedCells.ptr<uchar>(row);
+        for (int col = 0; col < m_activityMap.cols; ++col) {
+            double weight = std::min(activity[col] / m_suppressActivity, 1.0) * 0.5;
+            cv::Scalar color(0, 255, 255);
+            if (suppressed[col]) {
+                weight = 0.6;
+                color = cv::Scalar(0, 0, 255);
+            }
+            if (weight < 0.05)
+                continue;
+            cv::Mat cell = image(cv::Rect(col * cellSize, row * cellSize, cellSize, cellSize) & frameRect);
+            cv::addWeighted(cell, 1 - weight, cv::Mat(cell.size(), cell.type(), color), weight, 0, cell);
         }
-        return true;
     }
+    return cv::imwrite(path, image);
 }
 
-            size_t idxRingBuf = (n * idxSteps);
 
-            // preIdx -> reverse index of circular buffer (head = oldest index)
-            int preIdx = - static_cast<int>((diagBuf.size() - 1) - (n * idxSteps));
-            // std::cout << "pre idx: " << preIdx << std::endl;
-            diagBuf.at(idxRingBuf).preIdx = preIdx;
+void MotionDetector::suppressActivity(double fraction)
+{
+    /* limit between 0 (disabled) and 1 */
+    fraction = fraction > 1 ? 1 : fraction;
+    fraction = fraction < 0 ? 0 : fraction;
+    m_suppressActivity = fraction;
+}
+
+
+double MotionDetector::suppressActivity() const
+{
+    return m_suppressActivity;
+}
+
+
+int MotionDetector::suppressedCells() const
+{
+    return m_suppressedCount;
+}
+
+
+cv::Mat MotionDetector::suppressionMask() const
+{
+    return m_suppressedCells;
+}
+
+
+void MotionDetector::suppressionTime(int frames)
+{
+    m_suppressionTime = frames < 1 ? 1 : frames;
+}
+
+
+int MotionDetector::suppressionTime() const
+{
+    return m_suppressionTime;
+}
+
+
+/* long-term activity per cell: low pass of active cell (0, 1), time constant suppressionTime
+ * above suppressActivity: cell skipped by engine, mask cleared there, so activity of suppressed
+ * cell only decays (10 times slower), below half of suppressActivity cell is released and its
+ * background restarts with current frame (stale after suppression)
+ * frames: since last update step */
+void MotionDetector::updateSuppression(int frames)
+{
+    SegmentStats& stats = engineStats();
+    if (m_suppressActivity <= 0 || m_cellCounts.empty() || stats.cellSize <= 0) {
+        m_activityMap.release();
+        m_suppressedCells.release();
+        m_suppressedCount = 0;
+        stats.skipCells.release();
+        return;
+    }
+    // cells of other frame size (roi, scale): learning restarts
+    if (m_activityMap.size() != m_cellCounts.size()) {
+        m_activityMap.create(m_cellCounts.size(), CV_32F);
+        m_activityMap.setTo(cv::Scalar(0));
+        m_suppressedCells.create(m_cellCounts.size(), CV_8UC1);
+        m_suppressedCells.setTo(cv::Scalar(0));
+        m_suppressedCount = 0;
+    }
 
-            printDetectionParams(diagBuf.at(idxRingBuf));
-            diagPicBuffer.push_back(diagBuf.at(idxRingBuf));
+    const double rate = 1 - std::pow(1 - 1.0 / m_suppressionTime, frames);
+    const float activeRate = static_cast<float>(rate);
+    const float suppressedRate = static_cast<float>(rate / 10);
+    const float suppressLevel = static_cast<float>(m_suppressActivity);
+    const float releaseLevel = suppressLevel / 2;
+    const int cellSize = stats.cellSize;
+    for (int row = 0; row < m_cellCounts.rows; ++row) {
+        const int* count = m_cellCounts.ptr<int>(row);
+        float* activity = m_activityMap.ptr<float>(row);
+        uchar* suppressed = m_suppressedCells.ptr<uchar>(row);
+        for (int col = 0; col < m_cellCounts.cols; ++col) {
+            if (suppressed[col]) {
+                activity[col] -= suppressedRate * activity[col];
+                if (activity[col] < releaseLevel) {
+                    suppressed[col] = 0;
+                    --m_suppressedCount;
+                    cv::Rect cell(col * cellSize, row * cellSize, cellSize, cellSize);
+                    std::visit([&](auto& engine) { engine.refresh(m_processedFrame, cell); }, m_engine);
+                }
+            } else {
+                float active = isCellActive(count[col]) ? 1.0f : 0.0f;
+                activity[col] += activeRate * (active - activity[col]);
+                if (activity[col] > suppressLevel) {
+                    suppressed[col] = UCHAR_MAX;
+                    ++m_suppressedCount;
+                }
+            }
         }
-        return true;
     }
+    // no suppressed cell: engine sweeps continuous bands
+    if (m_suppressedCount > 0)
+        stats.skipCells = m_suppressedCells;
+    else
+        stats.skipCells.release();
+}
+
+
+// per zone: intensity, duration and continuous motion, hysteresis as whole frame
+// frames: since last update step, true: motion in any zone
+bool MotionDetector::updateZones(const std::vector<int>& zoneCounts, int frames)
+{
+    bool isMotion = false;
+    for (size_t n = 0; n < m_zones.size(); ++n) {
+        MotionZone& zone = m_zones[n];
+        zone.motionIntensity = n + 1 < zoneCounts.size() ? zoneCounts[n + 1] : 0;
+        bool isZoneMotion = zone.area > 0
+                && zone.motionIntensity * 100.0 > zone.minMotionArea * zone.area;
+
+        if (isZoneMotion) {
+            zone.motionDuration = std::min(zone.motionDuration + (zone.isMotion ? frames : 1),
+                                           zone.minMotionDuration);
+        } else {
+            zone.motionDuration = std::max(zone.motionDuration - frames, 0);
+        }
+        zone.isMotion = isZoneMotion;
+        if (zone.motionDuration >= zone.minMotionDuration) {
+            zone.isContinuousMotion = true;
+        } else if (zone.motionDuration == 0) {
+            zone.isContinuousMotion = false;
+        }
+        isMotion = isMotion || isZoneMotion;
+    }
+    return isMotion;
 }
 
 
-void printDetectionParams(MotionDiagPic& 
-void printDetectionParams(MotionDiagPic& 
+int MotionDetector::vectorMotion(cv::Mat mvMagnitude)
+{
+    assert(mvMagnitude.type() == CV_32F);
+
+    // macroblocks touched by roi
+    cv::Rect mbRoi = frameRoi(mvMagnitude.size(), 16);
+    cv::Mat mvRoi = mvMagnitude(mbRoi);
+
+    // macroblocks with motion, no pre-processing or background model needed
+    // compare: CV_8U mask directly, processed frame keeps its type (no reallocation per frame)
+    cv::compare(mvRoi, m_mvThreshold, m_motionMask, cv::CMP_GT);
+
+    // one cell per macroblock
+    m_motionMask.convertTo(m_cellCounts, CV_32S, 1.0 / UCHAR_MAX);
+    m_cellArea = 1;
+    m_cellPixels = 16 * m_scaleFrame;
+
+    // zones: macroblocks with motion per label
+    if (!m_zones.empty()) {
+        if (m_zoneLabels.size() != m_motionMask.size())
+            rasterizeZones(m_motionMask.size(), cv::Point2d(mbRoi.x * 16, mbRoi.y * 16), 1.0 / 16);
+        m_zoneCounts.assign(UCHAR_MAX + 1, 0);
+        for (int row = 0; row < m_motionMask.rows; ++row) {
+            const uchar* fg = m_motionMask.ptr<uchar>(row);
+            const uchar* label = m_zoneLabels.ptr<uchar>(row);
+            for (int col = 0; col < m_motionMask.cols; ++col)
+                m_zoneCounts[label[col]] += fg[col] ? 1 : 0;
+        }
+    }
+
+    // diag pic: magnitude (1 pixel -> 16 gray levels) in size of detection frame
+    cv::Size diagSize(cvRound(mvRoi.cols * 16 * m_scaleFrame),
+                      cvRound(mvRoi.rows * 16 * m_scaleFrame));
+    mvRoi.convertTo(m_processedFrame, CV_8U, 16);
+    cv::resize(m_processedFrame, m_resizedFrame, diagSize, 0, 0, cv::INTER_NEAREST);
+
+    // intensity as number of pixels of scaled frame (comparable to pixel input)
+    double mbPixels = 16 * m_scaleFrame * 16 * m_scaleFrame;
+    return cvRound(cv::countNonZero(m_motionMask) * mbPixels);
+}
+
+
+// current mask packed into history, k of n vote, cells and zones recounted from voted mask
+// returns foreground bits of voted mask
+int MotionDetector::voteMotion()
+{
+    // current mask packed into buffer of voted mask, overwritten by vote
+    packMask(m_motionMask, m_votedMask);
+    int planeRows = m_votedMask.rows;
+
+    // history restarts, if size of analysed frame or number of frames changed
+    if (m_voteHistory.rows != planeRows * m_voteFrames || m_voteHistory.cols != m_votedMask.cols) {
+        m_voteHistory.create(planeRows * m_voteFrames, m_votedMask.cols, CV_8UC1);
+        m_voteHistory.setTo(cv::Scalar(0));
+        m_voteIndex = 0;
+    }
+    m_votedMask.copyTo(m_voteHistory.rowRange(m_voteIndex * planeRows, (m_voteIndex + 1) * planeRows));
+    m_voteIndex = (m_voteIndex + 1) % m_voteFrames;
+    voteMasks(m_voteHistory, m_voteFrames, m_voteMinimum, m_votedMask);
+
+    // cells: macroblocks (vectors) or cells of background subtractor
+    int cellSize = m_motionInput == MotionInput::vectors ? 1 : engineStats().cellSize;
+    if (cellSize > 0)
+        countPackedCells(m_votedMask, m_motionMask.cols, cellSize, m_cellCounts);
+    for (size_t n = 0; n < m_zoneMasks.size() && n + 1 < m_zoneCounts.size(); ++n)
+        m_zoneCounts[n + 1] = popcountMask(m_votedMask, m_zoneMasks[n]);
+
+    return popcountMask(m_votedMask);
+}
+
+
+void MotionDetector::voteFrames(int frames)
+{
+    /* limit between 1 (disabled) and 32 */
+    frames = frames > 32 ? 32 : frames;
+    frames = frames < 1 ? 1 : frames;
+    m_voteFrames = frames;
+    m_voteMinimum = std::min(m_voteMinimum, m_voteFrames);
+    m_voteHistory.release();
+    m_votedMask.release();
+}
+
+
+int MotionDetector::voteFrames() const
+{
+    return m_voteFrames;
+}
+
+
+void MotionDetector::voteMinimum(int votes)
+{
+    /* limit between 1 and voteFrames */
+    votes = votes > m_voteFrames ? m_voteFrames : votes;
+    votes = votes < 1 ? 1 : votes;
+    m_voteMinimum = votes;
+}
+
+
+int MotionDetector::voteMinimum() const
+{
+    return m_voteMinimum;
+}
+
+
+void MotionDetector::warmUpFrames(int frames)
+{
+    m_warmUpFrames = frames < 0 ? 0 : frames;
+}
+
+
+int MotionDetector::warmUpFrames() const
+{
+    return m_warmUpFrames;
+}
+
+
+void MotionDetector::wake()
+{
+    m_idleCount = 0;
+}
+
+
+void MotionDetector::zones(const std::vector<MotionZone>& zones)
+{
+    m_zones = zones;
+    for (MotionZone& zone : m_zones) {
+        /* limits as for whole frame */
+        zone.bgrSubThreshold = std::min(std::max(zone.bgrSubThreshold, 0.0), 100.0);
+        zone.minMotionArea = std::min(std::max(zone.minMotionArea, 0.0), 100.0);
+        zone.minMotionDuration = std::min(std::max(zone.minMotionDuration, 0), 300);
+        zone.area = 0;
+        zone.motionDuration = 0;
+        zone.motionIntensity = 0;
+        zone.isContinuousMotion = false;
+        zone.isMotion = false;
+    }
+    // rasterized with next frame
+    m_zoneLabels.release();
+    m_zoneMasks.clear();
+    m_zoneThresholds.release();
+    m_zoneCounts.clear();
+    engineStats().labels.release();
+    engineStats().thresholds.release();
+}
+
+
+std::vector<MotionZone> MotionDetector::zones() const
+{
+    return m_zones;
+}
+
+
+
+// FUNCTIONS
+bool createDiagPics(CircularBuffer<MotionDiagPic>& diagBuf, std::vector<MotionDiagPic>& diagPicBuffer)
+{
+    diagPicBuffer.clear();
+
+    // number of diag pics, evenly distributed over circular buffer
+    const size_t nDiagPics = 5;
+    if (diagBuf.size() < nDiagPics) {
+        std::cout << "not enough samples in diag buffer: " << diagBuf.size() << std::endl;
+        return false;
+    } else {
+        size_t idxSteps = (diagBuf.size() - 1) / (nDiagPics - 1);
+        for (size_t n = 0; n < nDiagPics; ++n) {
+            size_t idxRingBuf = (n * idxSteps);
+
             // preIdx -> reverse index of circular buffer (head = oldest index)
             int preIdx = - static_cast<int>((diagBuf.size() - 1) - (n * idxSteps));
             // std::cout << "pre idx: " << preIdx << std::endl;
             diagBuf.at(idxRingBuf).preIdx = preIdx;
 
-            printDetectionParams(diagBuf.at(idxRingBuf));
-            diagPicBuffer.push_back(diagBuf.at(idxRingBuf));
+            // deep copy: buffers of circular buffer are overwritten in place by next frames
+            MotionDiagPic sample = diagBuf.at(idxRingBuf);
+            sample.frame = sample.frame.clone();
+            // motion cells -> size of frame
+            if (!sample.motion.empty() && sample.motion.size() != sample.frame.size()) {
+                cv::resize(sample.motion, sample.motion, sample.frame.size(), 0, 0, cv::INTER_NEAREST);
+            } else {
+                sample.motion = sample.motion.clone();
+            }
+
+            printDetectionParams(sample);
+            diagPicBuffer.push_back(sample);
         }
         return true;
     }
@@ -254,6 +1549,13 @@ void printDetectionParams(MotionDiagPic& diagSample)
     ssIntensity << "intensity: " << diagSample.motionIntensity;
     cv::putText(diagSample.frame, ssIntensity.str(), orgIntensity, fontFace,
                 fontScale, red, fontThickness);
+
+    // packet score
+    cv::Point orgPacketScore(orgX, orgY + 2 * (fontHeight + spaceY));
+    std::stringstream ssPacketScore;
+    ssPacketScore << "packet score: " << std::fixed << std::setprecision(1) << diagSample.packetScore;
+    cv::putText(diagSample.frame, ssPacketScore.str(), orgPacketScore, fontFace,
+                fontScale, red, fontThickness);
 }
 
 
@@ -1,32 +1,94 @@
 #ifndef MOTIONDETECTOR_H
 #define MOTIONDETECTOR_H
-#include "backgroundsubtraction.h"
 #include "circularbuffer.h"
+#include "detector-engines.h"
 #include "perfcounter.h"
 
 #include <opencv2/opencv.hpp>
 
-enum class MotionMinimal {intensity, duration};
-enum class Duration {frames, seconds};
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
 
-// TODO
-// setMotionArea - in per cent of frame area
-// setMotionDuration - in sec, in number of frames (alternative)
-// setMotionRoi - in cv::Rect
+enum class MotionMinimal {intensity, duration};
+enum class MotionInput {pixels, vectors};
 
 
 // CLASSES
+/// detection zone with own thresholds and motion state
+/// several zones are evaluated in one sweep of background subtraction
+struct MotionZone
+{
+    std::string             name;
+    std::vector<cv::Point>  polygon;    // pixels of detection stream, as roi
+    double                  bgrSubThreshold;
+    double                  minMotionArea; // per cent of zone area
+    int                     minMotionDuration;
+    // state, updated by MotionDetector
+    int                     area;       // pixels (macroblocks) of analysed frame in zone
+    int                     motionDuration;
+    int                     motionIntensity;
+    bool                    isContinuousMotion;
+    bool                    isMotion;   // at last update step
+    char                    avoidPaddingWarning1[6];
+};
+
+
+/// learned state of MotionDetector, see saveState, restoreState
+struct DetectorState
+{
+    cv::Mat     background;     // accumulator of engine, empty: none
+    cv::Size    frameSize;      // of frames passed to detector
+    cv::Rect    roi;
+    double      scaleFrame;
+    double      alpha;          // parameters at time of saving (informational)
+    double      bgrSubThreshold;
+    EngineType  engine;
+    int         motionDuration;
+    int         idleCount;
+    int         tamperCount;
+    int         warmUpCount;
+    char        avoidPaddingWarning1[4];
+    double      refEdges;
+    std::array<double, 16> refRegions;
+};
+
+
 struct DetectorParams
 {
     double      bgrSubThreshold;
+    double      minMotionArea; // per cent of analysed area (roi after scaling)
+    double      mvThreshold; // motion vector magnitude in pixels per frame
     int         minMotionDuration;
-    int         minMotionIntensity;
     int         postCapture; // preCapture determined by key frame distance
     int         preCapture;  // reseved for future usage
-    cv::Rect    roi;
+    int         idleDelay;   // update steps w/o motion before idle, 0: disabled
+    cv::Rect    roi;         // pixels of detection stream, empty: full frame
     double      scaleFrame;
+    std::vector<MotionZone> zones; // empty: roi with thresholds above
+    std::string stateFile;   // background saved at exit, restored at start, empty: disabled
+    std::string suppressionImage; // learned suppression mask for review, empty: not written
+    EngineType  engine;
+    int         minActiveCells; // 16x16 cells with motion, 0: trigger by minMotionArea
+    int         maxBlobCount; // more blobs: scattered noise, 0: unlimited
+    double      minBlobArea; // per cent of analysed area, 0: blob filter disabled
+    int         voteFrames;  // temporal voting over masks of last n update steps, 1: disabled
+    int         voteMinimum; // pixel is foreground in at least k of n masks
+    int         threads;     // detection stripes in parallel, 1: serial
+    int         tamperDuration; // frames of whole-frame change until tamper, 0: disabled
+    double      globalChangeArea; // per cent foreground restarting background, 0: disabled
+    double      suppressActivity; // long-term fraction of active cell excluding it, 0: disabled
+    double      cascadeThreshold; // coarse stage gray level difference, 0: fine stage every frame
+    int         seedFrames;  // median background seed after (re)connect
+    int         warmUpFrames; // learning rate decays to alpha, 0: no warm-up
+    int         stateMaxAge; // seconds, older state file or interruption: background seeded
+    int         suppressionTime; // frames, time constant of long-term cell activity
+    int         cascadeTail; // frames of fine stage after coarse activity
+    int         cascadeRefresh; // frames, fine stage at least every n frames
     bool        debug;
-    char        avoidPaddingWarning1[7];
+    bool        motionVectors; // detect motion by h264 motion vectors instead of pixels
+    char        avoidPaddingWarning1[6];
 };
 
 
@@ -37,37 +99,263 @@ public:
     /* background subtractor: threshold of frame difference */
     void        bgrSubThreshold(double threshold);
     double      bgrSubThreshold() const;
-    bool        hasFrameMotion(cv::Mat frame);
-    bool        isContinuousMotion(cv::Mat frame);
-    /* duration as number of update steps */
+    /* blobs of at least minBlobArea in last frame, see minBlobArea */
+    int         blobCount() const;
+    /* two-stage cascade: coarse stage (block means of roi at 1/4 of scaleFrame, e.g. 1/16,
+     * against own low pass background) runs every frame, fine stage (background subtraction
+     * of analysed frame, voting, blobs, intensity) only if a block differs by more than
+     * cascadeThreshold gray levels, for cascadeTail frames afterwards and every cascadeRefresh
+     * frames (fine background keeps learning, tamper and global change keep counting)
+     * coarse foreground counts in zones and outside of suppressed cells only, coarse background
+     * restarts with global change, seed and restore of fine stage
+     * fine stage runs on the frame which activated the coarse stage: no additional latency
+     * static frames: no motion, cells and zone counts zero, processed frame and mask not updated
+     * pixel input only, 0: disabled (default), e.g. 8 */
+    void        cascadeThreshold(double threshold);
+    double      cascadeThreshold() const;
+    /* frames, default 25 */
+    void        cascadeRefresh(int frames);
+    int         cascadeRefresh() const;
+    /* frames, default 25 */
+    void        cascadeTail(int frames);
+    int         cascadeTail() const;
+    /* segmentation engine, see EngineType
+     * change restarts background with next frame, keeps alpha, threshold and zones */
+    void        engine(EngineType type);
+    EngineType  engine() const;
+    /* nominal duration of one frame in seconds (1 / frame rate), 0: no time stamps (default)
+     * durations (minMotionDuration) are numbers of frames at this rate */
+    void        frameDuration(double seconds);
+    double      frameDuration() const;
+    /* global change (ir cut filter, exposure jump, headlights): foreground of more than
+     * percent of analysed area (zones) and luminance of most regions of analysed frame
+     * shifted by a similar amount against its reference (learning at background rate)
+     * background restarts with current frame, no motion in this update step
+     * 0: disabled, default 60 */
+    void        globalChangeArea(double percent);
+    double      globalChangeArea() const;
+    /* frameStep: number of frames since last update (> 1, if frames were skipped)
+     * scales learning rate of background subtractor
+     * timeStamp: presentation time of frame in seconds (pts * time base), < 0: not available
+     * with time stamps and frameDuration, frames since last update are measured by time:
+     * skipped or dropped frames count for learning rate and motion duration,
+     * trigger semantics do not depend on the number of analysed frames
+     * frame: gray scale image (MotionInput::pixels) or
+     * motion vector magnitudes per 16x16 macroblock, CV_32F (MotionInput::vectors) */
+    bool        hasFrameMotion(cv::Mat frame, int frameStep = 1, double timeStamp = -1);
+    /* idle: no motion for idleDelay update steps
+     * caller may reduce frame rate (e.g. key frames only) while idle,
+     * wakes up as soon as intensity exceeds half of minMotionIntensity */
+    void        idleDelay(int value);
+    int         idleDelay() const;
+    /* last update step evaluated by coarse stage of cascade only, see cascadeThreshold */
+    bool        isCoarseOnly() const;
+    bool        isContinuousMotion(cv::Mat frame, int frameStep = 1, double timeStamp = -1);
+    /* global change in last update step, background restarted */
+    bool        isGlobalChange() const;
+    bool        isIdle() const;
+    /* whole-frame change (see globalChangeArea) or texture lost against reference
+     * (covered, defocused) for tamperDuration frames, cleared as motion state */
+    bool        isTamper() const;
+    /* more blobs of at least minBlobArea: scattered noise (rain, snow), intensity 0
+     * 0: unlimited (default) */
+    void        maxBlobCount(int value);
+    int         maxBlobCount() const;
+    /* trigger by number of active cells (more than 1/8 of cell is foreground)
+     * evaluation stops as soon as value is reached, 0: trigger by minMotionArea (default) */
+    void        minActiveCells(int value);
+    int         minActiveCells() const;
+    /* blob filter: connected active cells (connected foreground pixels, if cells are disabled)
+     * are one blob, intensity counts foreground of blobs with at least minBlobArea only
+     * per cent of analysed area, as minMotionArea, 0: disabled (default) */
+    void        minBlobArea(double percent);
+    double      minBlobArea() const;
+    /* minimum area with motion in per cent of analysed area (roi after scaling)
+     * stays valid, if roi or scale factor changes */
+    void        minMotionArea(double percent);
+    double      minMotionArea() const;
+    /* duration as number of update steps, number of frames if time stamps are available
+     * motion duration grows by frames since last update, if motion was detected at last
+     * update, too (by 1 else), and decays by frames since last update */
     void        minMotionDuration(int value);
     int         minMotionDuration() const;
     int         motionDuration() const;
-    /* intensity area as pixels
-     * TODO: as per cent of frame area
-     */
-    void        minMotionIntensity(int value);
+    /* minimum area with motion as pixels of last analysed frame */
     int         minMotionIntensity() const;
+    /* bounding box of active cells in pixels of resized frame, empty: no motion */
+    cv::Rect    motionBox() const;
+    /* foreground fraction per cell (16x16 pixels or macroblock), CV_8U 0 ... 255
+     * small replacement of motion mask for diag pic history */
+    cv::Mat     motionCells() const;
+    /* as above, written into buffer of caller, no allocation if size is unchanged */
+    void        motionCells(cv::Mat& cells) const;
     int         motionIntensity() const;
+    /* pixels: background subtraction of decoded frames (default)
+     * vectors: macroblock motion vectors exported by decoder */
+    void        motionInput(MotionInput input);
+    MotionInput motionInput() const;
     cv::Mat     motionMask() const;
+    /* 1 bit per pixel of analysed frame, see packMask, voted mask if voting is enabled
+     * empty, if voting is disabled */
+    cv::Mat     packedMask() const;
+    /* minimum motion vector magnitude in pixels of macroblock with motion */
+    void        mvThreshold(double value);
+    double      mvThreshold() const;
     cv::Mat     processedFrame() const;
+    /* background seeded from median of next seedFrames analysed frames (transient objects
+     * removed), no motion meanwhile, e.g. after reconnect, then warm-up, see warmUpFrames */
     void        resetBackground();
     cv::Mat     resizedFrame() const;
-    /* region of interest related to upper left corner */
+    /* background saved by saveState, memory mapped and validated against engine, roi,
+     * scale factor and age (seconds), background and hysteresis counters are applied with
+     * first frame of same size, else background is seeded (resetBackground)
+     * false: no valid state, background unchanged */
+    bool        restoreState(const std::string& path, int maxAge = 600);
+    /* region of interest related to upper left corner of frame
+     * cropped before scaling, empty rect: full frame */
     void        roi(cv::Rect);
     cv::Rect    roi() const;
-    // TODO reset backgroundsubtractor
+    /* scale factor of frame before background subtraction */
+    void        scaleFrame(double value);
+    double      scaleFrame() const;
+    /* frames of whole-frame change until tamper is flagged, 0: disabled (default) */
+    void        tamperDuration(int frames);
+    int         tamperDuration() const;
+    /* background and hysteresis counters as compact binary file, written atomically
+     * false: no background (motion vectors, mog2, no frame yet) or write error */
+    bool        saveState(const std::string& path) const;
+    /* frames of median background seed of resetBackground, 1 ... 15, default 5 */
+    void        seedFrames(int frames);
+    int         seedFrames() const;
+    /* learned suppression of permanently moving regions (trees, flags, busy street):
+     * long-term activity per cell (fraction of update steps with active cell, time constant
+     * suppressionTime frames), cells above fraction are not segmented (skipped in kernels,
+     * no foreground, background kept), released below half of fraction (decay 10 times slower)
+     * pixel input with cells only, 0: disabled (default), e.g. 0.3 */
+    void        suppressActivity(double fraction);
+    double      suppressActivity() const;
+    /* number of cells suppressed */
+    int         suppressedCells() const;
+    /* suppressed cells, CV_8U per cell, != 0: suppressed, empty: disabled */
+    cv::Mat     suppressionMask() const;
+    /* resized frame with long-term activity (yellow) and suppressed cells (red) for review
+     * false: no mask yet or write error */
+    bool        saveSuppressionMask(const std::string& path) const;
+    /* frames, default 15000 (10 min at 25 fps) */
+    void        suppressionTime(int frames);
+    int         suppressionTime() const;
+    /* threads of downscale, blur and segmentation: frame split into horizontal stripes,
+     * processed by persistent worker pool, intensity, cells and zones identical to 1 thread
+     * 1: serial (default), e.g. 4 for high resolution analysis on raspberry pi */
+    void        threads(int value);
+    int         threads() const;
+    /* k of n temporal voting: pixel (macroblock) is foreground, if it is foreground
+     * in at least voteMinimum of the last voteFrames masks, suppresses flicker noise
+     * masks kept 1 bit per pixel, intensity, cells and zones counted by popcount
+     * voteFrames 1: disabled (default), 32 at max */
+    void        voteFrames(int frames);
+    int         voteFrames() const;
+    void        voteMinimum(int votes);
+    int         voteMinimum() const;
+    /* learning rate schedule after background (re)start (first frame, reset, reconnect,
+     * roi or scale changed, global change): decays from 1/2 to alpha in warmUpFrames frames,
+     * log scale, 0: alpha from start, default 50 */
+    void        warmUpFrames(int frames);
+    int         warmUpFrames() const;
+    /* leave idle mode, e.g. woken by packet size pre-detector */
+    void        wake();
+    /* zones inside roi, pixels outside of all zones are ignored, later zone wins on overlap
+     * continuous motion, as soon as one zone has continuous motion, empty: whole roi */
+    void        zones(const std::vector<MotionZone>& zones);
+    std::vector<MotionZone> zones() const;
 private:
-    cv::Ptr<BackgroundSubtractorLowPass> m_bgrSub;
+    void        applyState(cv::Size frameSize);
+    int         blobMotion();
+    bool        coarseMotion(const cv::Mat& frame, int frameStep);
+    int         countActiveCells(int limit) const;
+    int         elapsedFrames(double timeStamp);
+    SegmentStats& engineStats();
+    cv::Rect    frameRoi(cv::Size frameSize, int cellSize) const;
+    bool        globalChange(int foregroundCount, int frames);
+    bool        isCellActive(int count) const;
+    int         pixelMotion(cv::Mat frame, int frameStep);
+    void        seedBackground();
+    void        rasterizeZones(cv::Size size, cv::Point2d offset, double scale);
+    void        updateSuppression(int frames);
+    bool        updateZones(const std::vector<int>& zoneCounts, int frames);
+    int         vectorMotion(cv::Mat mvMagnitude);
+    int         voteMotion();
+    cv::Mat     m_activityMap;      // long-term fraction of update steps per cell, CV_32F
+    std::vector<int> m_blobAreas;   // foreground per component label
+    cv::Mat     m_blobCentroids;
+    int         m_blobCount;
+    cv::Mat     m_blobLabels;
+    cv::Mat     m_blobMap;          // active cells
+    cv::Mat     m_blobStats;
+    int         m_cascadeRefresh;
+    int         m_cascadeTail;
+    double      m_cascadeThreshold;
+    int         m_cellArea;
+    cv::Mat     m_cellCounts;
+    double      m_cellPixels; // cell width in pixels of resized frame
+    SegmentEngine<LowPassModel> m_coarseEngine; // coarse stage of cascade, w/o cells
+    cv::Mat     m_coarseFrame;      // block means of roi
+    cv::Mat     m_coarseMask;
+    cv::Mat     m_coarsePooled;
+    int         m_coarseSkipped;    // frames of coarse stage only since last fine stage
+    int         m_coarseTail;       // frames left, in which fine stage runs after coarse activity
+    DetectorEngine m_engine;
+    double      m_frameDuration; // seconds, 0: update steps counted
+    cv::Size    m_frameSize;    // of last analysed frame
+    double      m_globalChangeArea;
+    int         m_idleCount;
+    int         m_idleDelay;
+    bool        m_isCoarseOnly;
     bool        m_isContinuousMotion;
+    bool        m_isGlobalChange;
+    bool        m_isMotion;     // at last update step
+    bool        m_isTamper;
+    int         m_maxBlobCount;
+    int         m_minActiveCells;
+    double      m_minBlobArea;
+    double      m_minMotionArea;
     int         m_minMotionDuration;
     int         m_minMotionIntensity;
     int         m_motionDuration;
+    MotionInput m_motionInput;
     int         m_motionIntensity;
     cv::Mat     m_motionMask;
+    double      m_mvThreshold;
     cv::Mat     m_resizedFrame;
     cv::Mat     m_processedFrame;
+    double      m_refEdges;     // edge energy (mean gradient), < 0: no reference
+    std::array<double, 16> m_refRegions; // mean luminance of 4x4 regions
+    DetectorState m_restoreState; // applied with first frame, empty background: none
     cv::Rect    m_roi;
+    double      m_scaleFrame;
+    std::vector<cv::Mat> m_seedBuffer; // analysed frames of median seed
+    int         m_seedCount;    // frames in seed buffer, < 0: not seeding
+    int         m_seedFrames;
+    double      m_suppressActivity;
+    cv::Mat     m_suppressedCells;  // CV_8U per cell, skip map of engine
+    int         m_suppressedCount;
+    int         m_suppressionTime;
+    int         m_tamperCount;  // frames, hysteresis as motion duration
+    int         m_tamperDuration;
+    double      m_timeStamp;    // of last update step, seconds, < 0: none
+    int         m_voteFrames;
+    cv::Mat     m_votedMask;        // packed
+    cv::Mat     m_voteHistory;      // packed masks of last voteFrames steps, stacked vertically
+    int         m_voteIndex;        // plane of history overwritten next
+    int         m_voteMinimum;
+    int         m_warmUpCount;  // frames since background (re)start
+    int         m_warmUpFrames;
+    std::unique_ptr<WorkerPool> m_workers; // null: serial
+    cv::Mat     m_zoneLabels;       // zone index + 1 per pixel of analysed frame
+    std::vector<cv::Mat> m_zoneMasks; // packed mask per zone, used by voting
+    std::vector<int> m_zoneCounts;  // foreground per label of last frame
+    std::vector<MotionZone> m_zones;
+    cv::Mat     m_zoneThresholds;   // bgrSubThreshold per pixel of analysed frame
 };
 
 
@@ -78,6 +366,7 @@ struct MotionDiagPic
     int     motionDuration;
     int     motionIntensity;
     int     preIdx;
+    double  packetScore; // packet size pre-detector
 };
 
 
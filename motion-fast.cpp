@@ -1,5 +1,7 @@
 #include "avreadwrite.h"
+#include "framering.h"
 #include "motion-detector.h"
+#include "packet-detector.h"
 #include "perfcounter.h"
 #include "safebuffer.h"
 #include "time-stamp.h"
@@ -18,6 +20,7 @@
 #include <QSettings>
 
 // std
+#include <algorithm> // max, min
 #include <atomic>
 #include <condition_variable>
 #include <iomanip>
@@ -57,7 +60,9 @@ struct Params
     Params();
     Params(const Params&) = default;
     ~Params();
+    DecoderParams       decoder;
     DetectorParams      detector;
+    PacketDetectorParams packet;
     void                loadSettings();
     void                saveSettings();
 };
@@ -66,20 +71,28 @@ struct Params
 struct State
 {
     std::thread                 threadMotionDetection;
+    std::thread                 threadReadSubstream;
     std::thread                 threadWritePackets;
+    DecoderParams               decoder;
     DetectorParams              detector;
     MotionCondition             motion;
     std::vector<MotionDiagPic>  motionDiag;
-    VideoStream                 streamInfo;
+    PacketDetectorParams        packet;
+    VideoStream                 streamInfo;       // main stream -> recording
+    VideoStream                 detectStreamInfo; // substream or main stream -> motion detection
     long long                   errorCount;
     TimePoint                   timeLastError;
     std::condition_variable     resetDoneCnd;
     std::mutex                  resetDoneMtx;
+    std::atomic_uint            streamGeneration; // incremented with each (re)opened stream
     bool                        reset;
     bool                        resetDone;
     bool                        terminate;
     bool                        debug;
-    char                        avoidPaddingWarning1[4];
+    std::atomic_bool            substreamError;
+    std::atomic_bool            substreamStop;
+    bool                        useSubstream;
+    char                        avoidPaddingWarning1[5];
 };
 
 
@@ -91,6 +104,11 @@ enum class WriteState
 };
 
 
+// FUNCTIONS (settings)
+std::vector<cv::Point> polygonFromString(const QString& text);
+QString polygonToString(const std::vector<cv::Point>& polygon);
+
+
 
 // MEMBER FUNCTIONS
 // TODO move to separate class PersistentParams
@@ -108,15 +126,112 @@ void Params::loadSettings()
 {
     QSettings settings;
 
+    settings.beginGroup("Decoder");
+    decoder.lowres = settings.value("lowres", 1).toInt();
+    QString quality = settings.value("quality", "full").toString();
+    decoder.quality = quality == "detection" ? DecodeQuality::detection : DecodeQuality::full;
+    QString idleFrames = settings.value("idleFrames", "key").toString();
+    if (idleFrames == "key") {
+        decoder.idleFrames = DecodeFrames::key;
+    } else if (idleFrames == "reference") {
+        decoder.idleFrames = DecodeFrames::reference;
+    } else {
+        decoder.idleFrames = DecodeFrames::all;
+    }
+    decoder.threadCount = settings.value("threadCount", 1).toInt();
+    QString threadType = settings.value("threadType", "frame").toString();
+    if (threadType == "frame") {
+        decoder.threadType = DecodeThreading::frame;
+    } else if (threadType == "slice") {
+        decoder.threadType = DecodeThreading::slice;
+    } else {
+        decoder.threadType = DecodeThreading::none;
+    }
+    settings.endGroup();
+
     settings.beginGroup("MotionDetector");
+    // legacy bgrSubModel fixed16: Q8.8 running average
+    QString engine = settings.value("bgrSubModel", "float32").toString() == "fixed16"
+            ? engineName(EngineType::runningAverage) : engineName(EngineType::lowPass);
+    detector.engine = engineFromName(settings.value("engine", engine).toString().toStdString());
     detector.bgrSubThreshold = settings.value("bgrSubThreshold", 40).toDouble();
+    detector.cascadeRefresh = settings.value("cascadeRefresh", 25).toInt();
+    detector.cascadeTail = settings.value("cascadeTail", 25).toInt();
+    detector.cascadeThreshold = settings.value("cascadeThreshold", 0).toDouble();
     detector.debug = settings.value("debug", false).toBool();
+    detector.globalChangeArea = settings.value("globalChangeArea", 60).toDouble();
+    detector.idleDelay = settings.value("idleDelay", 0).toInt();
+    // legacy minMotionIntensity: pixels of 1920x1080 frame scaled by 0.25
+    const double refArea = 480 * 270;
+    double minMotionArea = settings.value("minMotionIntensity", 80).toDouble() / refArea * 100;
+    detector.maxBlobCount = settings.value("maxBlobCount", 0).toInt();
+    detector.minActiveCells = settings.value("minActiveCells", 0).toInt();
+    detector.minBlobArea = settings.value("minBlobArea", 0).toDouble();
+    detector.minMotionArea = settings.value("minMotionArea", minMotionArea).toDouble();
     detector.minMotionDuration = settings.value("minMotionDuration", 30).toInt();
-    detector.minMotionIntensity = settings.value("minMotionIntensity", 80).toInt();
+    detector.motionVectors = settings.value("motionVectors", false).toBool();
+    detector.mvThreshold = settings.value("mvThreshold", 1.0).toDouble();
     QRect qRoi = settings.value("roi", QRect(0,0,0,0)).toRect();
     detector.postCapture = settings.value("postBuffer", 25).toInt();
     detector.roi = cv::Rect(qRoi.x(), qRoi.y(), qRoi.width(),qRoi.height());
     detector.scaleFrame = settings.value("scaleFrame", 0.25).toDouble();
+    detector.seedFrames = settings.value("seedFrames", 5).toInt();
+    detector.stateFile = settings.value("stateFile", "detector-state.bin").toString().toStdString();
+    detector.stateMaxAge = settings.value("stateMaxAge", 600).toInt();
+    detector.suppressActivity = settings.value("suppressActivity", 0).toDouble();
+    detector.suppressionImage = settings.value("suppressionImage", "suppression-mask.png").toString().toStdString();
+    detector.suppressionTime = settings.value("suppressionTime", 15000).toInt();
+    detector.tamperDuration = settings.value("tamperDuration", 0).toInt();
+    detector.threads = settings.value("threads", 1).toInt();
+    detector.voteFrames = settings.value("voteFrames", 1).toInt();
+    detector.voteMinimum = settings.value("voteMinimum", 1).toInt();
+    detector.warmUpFrames = settings.value("warmUpFrames", 50).toInt();
+    // detection zones, polygon "x,y x,y ..." in pixels of detection stream
+    // thresholds default to values of whole frame
+    detector.zones.clear();
+    int nZones = settings.beginReadArray("zones");
+    for (int n = 0; n < nZones; ++n) {
+        settings.setArrayIndex(n);
+        MotionZone zone{};
+        zone.name = settings.value("name", QString("zone %1").arg(n + 1)).toString().toStdString();
+        zone.polygon = polygonFromString(settings.value("polygon").toString());
+        zone.bgrSubThreshold = settings.value("bgrSubThreshold", detector.bgrSubThreshold).toDouble();
+        zone.minMotionArea = settings.value("minMotionArea", detector.minMotionArea).toDouble();
+        zone.minMotionDuration = settings.value("minMotionDuration", detector.minMotionDuration).toInt();
+        if (zone.polygon.size() >= 3) {
+            detector.zones.push_back(zone);
+        } else {
+            std::cout << "Zone " << zone.name << " ignored, polygon needs 3 points at least" << std::endl;
+        }
+    }
+    settings.endArray();
+    settings.endGroup();
+
+    // lowres frames are scaled by scaleFrame * 2^lowres to analysed resolution, clamped to 1:
+    // lowres limited, so that analysed resolution matches scaleFrame of detection stream
+    detector.scaleFrame = std::min(std::max(detector.scaleFrame, 0.0625), 1.0);
+    int lowres = std::max(decoder.lowres, 0);
+    while (lowres > 0 && detector.scaleFrame * (1 << lowres) > 1 + 1e-9)
+        --lowres;
+    if (lowres != decoder.lowres) {
+        std::cout << "Decoder lowres " << decoder.lowres << " reduced to " << lowres
+                  << ", scaleFrame " << detector.scaleFrame << " allows 1/" << (1 << lowres)
+                  << " at most" << std::endl;
+        decoder.lowres = lowres;
+    }
+
+    settings.beginGroup("PacketDetector");
+    packet.alpha = settings.value("alpha", 0.02).toDouble();
+    QString mode = settings.value("mode", "off").toString();
+    if (mode == "wake") {
+        packet.mode = PacketTrigger::wake;
+    } else if (mode == "trigger") {
+        packet.mode = PacketTrigger::trigger;
+    } else {
+        packet.mode = PacketTrigger::off;
+    }
+    packet.threshold = settings.value("threshold", 3.0).toDouble();
+    packet.warmUp = settings.value("warmUp", 25).toInt();
     settings.endGroup();
 }
 
@@ -124,15 +239,95 @@ void Params::saveSettings()
 {
     QSettings settings;
 
+    settings.beginGroup("Decoder");
+    switch (decoder.idleFrames) {
+    case DecodeFrames::key:
+        settings.setValue("idleFrames", "key");
+        break;
+    case DecodeFrames::reference:
+        settings.setValue("idleFrames", "reference");
+        break;
+    case DecodeFrames::all:
+        settings.setValue("idleFrames", "all");
+        break;
+    }
+    settings.setValue("lowres", decoder.lowres);
+    settings.setValue("quality", decoder.quality == DecodeQuality::detection ? "detection" : "full");
+    settings.setValue("threadCount", decoder.threadCount);
+    switch (decoder.threadType) {
+    case DecodeThreading::frame:
+        settings.setValue("threadType", "frame");
+        break;
+    case DecodeThreading::slice:
+        settings.setValue("threadType", "slice");
+        break;
+    case DecodeThreading::none:
+        settings.setValue("threadType", "none");
+        break;
+    }
+    settings.endGroup();
+
     settings.beginGroup("MotionDetector");
+    settings.remove("bgrSubModel");
     settings.setValue("bgrSubThreshold", detector.bgrSubThreshold);
+    settings.setValue("cascadeRefresh", detector.cascadeRefresh);
+    settings.setValue("cascadeTail", detector.cascadeTail);
+    settings.setValue("cascadeThreshold", detector.cascadeThreshold);
     settings.setValue("debug", detector.debug);
+    settings.setValue("engine", engineName(detector.engine));
+    settings.setValue("globalChangeArea", detector.globalChangeArea);
+    settings.setValue("idleDelay", detector.idleDelay);
+    settings.setValue("maxBlobCount", detector.maxBlobCount);
+    settings.setValue("minActiveCells", detector.minActiveCells);
+    settings.setValue("minBlobArea", detector.minBlobArea);
+    settings.setValue("minMotionArea", detector.minMotionArea);
+    settings.remove("minMotionIntensity");
     settings.setValue("minMotionDuration", detector.minMotionDuration);
-    settings.setValue("minMotionIntensity", detector.minMotionIntensity);
+    settings.setValue("motionVectors", detector.motionVectors);
+    settings.setValue("mvThreshold", detector.mvThreshold);
     QRect qRoi(detector.roi.x, detector.roi.y, detector.roi.width, detector.roi.height);
     settings.setValue("roi", qRoi);
     settings.setValue("postBuffer", detector.postCapture);
     settings.setValue("scaleFrame", detector.scaleFrame);
+    settings.setValue("seedFrames", detector.seedFrames);
+    settings.setValue("stateFile", QString::fromStdString(detector.stateFile));
+    settings.setValue("stateMaxAge", detector.stateMaxAge);
+    settings.setValue("suppressActivity", detector.suppressActivity);
+    settings.setValue("suppressionImage", QString::fromStdString(detector.suppressionImage));
+    settings.setValue("suppressionTime", detector.suppressionTime);
+    settings.setValue("tamperDuration", detector.tamperDuration);
+    settings.setValue("threads", detector.threads);
+    settings.setValue("voteFrames", detector.voteFrames);
+    settings.setValue("voteMinimum", detector.voteMinimum);
+    settings.setValue("warmUpFrames", detector.warmUpFrames);
+    settings.beginWriteArray("zones", static_cast<int>(detector.zones.size()));
+    for (size_t n = 0; n < detector.zones.size(); ++n) {
+        const MotionZone& zone = detector.zones[n];
+        settings.setArrayIndex(static_cast<int>(n));
+        settings.setValue("name", QString::fromStdString(zone.name));
+        settings.setValue("polygon", polygonToString(zone.polygon));
+        settings.setValue("bgrSubThreshold", zone.bgrSubThreshold);
+        settings.setValue("minMotionArea", zone.minMotionArea);
+        settings.setValue("minMotionDuration", zone.minMotionDuration);
+    }
+    settings.endArray();
+    settings.endGroup();
+
+    settings.beginGroup("PacketDetector");
+    settings.setValue("alpha", packet.alpha);
+    switch (packet.mode) {
+    case PacketTrigger::wake:
+        settings.setValue("mode", "wake");
+        break;
+    case PacketTrigger::trigger:
+        settings.setValue("mode", "trigger");
+        break;
+    case PacketTrigger::off:
+        settings.setValue("mode", "off");
+        break;
+    }
+    settings.setValue("threshold", packet.threshold);
+    settings.setValue("warmUp", packet.warmUp);
     settings.endGroup();
 }
 
@@ -140,11 +335,16 @@ void Params::saveSettings()
 
 // FUNCTIONS
 int detectMotion(PacketSafeQueue& packetQueue, State& appState);
+bool processSubstream(LibavReader& reader, PacketSafeQueue& decodeQueue, State& appState);
 bool processVideoStream(LibavReader& reader, PacketSafeQueue& decodeQueue,
                         PacketSafeCircularBuffer& preCaptureBuffer, State& appState);
+void reopenReader(LibavReader& reader, const std::string& input);
+void startSubstream(LibavReader& reader, PacketSafeQueue& decodeQueue, State& appState);
+void stopSubstream(State& appState);
 void resetWriter(State& appState, WriteState& writeState, LibavWriter& writer);
 long long secondsWithoutError(State& appState);
 void sigHandler(int signum);
+void signalMotion(bool isMotion, CircularBuffer<MotionDiagPic>& diagBuffer, State& appState);
 void terminateThreads(PacketSafeQueue& packetQueue, PacketSafeCircularBuffer& buffer, State& appState);
 void waitForMotion(State& appState);
 bool writeDiagPicsToDisk(std::vector<MotionDiagPic>& diagPicBuffer);
@@ -156,25 +356,260 @@ int writeMotionPackets(PacketSafeCircularBuffer& buffer, State& appState);
 int detectMotion(PacketSafeQueue& packetQueue, State& appState)
 {
     DEBUG(getTimeStampMs() << " " << __func__ << " #" << __LINE__ << ", thread motion started");
-    // PerfCounter decode("decoding");
-    // PerfCounter motion("motion detection");
 
     LibavDecoder decoder;
-    int ret = decoder.open(appState.streamInfo.videoCodecParameters);
+    decoder.lowres(appState.decoder.lowres);
+    decoder.quality(appState.decoder.quality);
+    decoder.threadCount(appState.decoder.threadCount);
+    decoder.threadType(appState.decoder.threadType);
+    decoder.exportMotionVectors(appState.detector.motionVectors);
+    int ret = decoder.open(appState.detectStreamInfo.videoCodecParameters);
     if (ret < 0){
         avErrMsg("Failed to open codec", ret);
         return ret;
     }
+    std::cout << getTimeStampMs() << " Decoder threads: " << decoder.threadCount()
+              << (decoder.threadType() == DecodeThreading::frame ? " (frame)"
+                  : decoder.threadType() == DecodeThreading::slice ? " (slice)" : "")
+              << std::endl;
+    if (decoder.quality() == DecodeQuality::detection) {
+        std::cout << getTimeStampMs() << " Decoder quality: detection, lowres: "
+                  << decoder.lowres() << std::endl;
+    }
+    // intra coded key frames carry no motion vectors: decode reference frames while idle
+    DecodeFrames idleFrames = appState.decoder.idleFrames;
+    if (decoder.exportMotionVectors()) {
+        if (idleFrames == DecodeFrames::key) {
+            idleFrames = DecodeFrames::reference;
+        }
+        std::cout << getTimeStampMs() << " Motion detection by motion vectors, threshold: "
+                  << appState.detector.mvThreshold << " px" << std::endl;
+    }
+    // frame threading: latency added by decoder in frames, max. reported
+    int frameDelay = 0;
+    double frameDuration = appState.detectStreamInfo.frameRate.num
+            ? av_q2d(av_inv_q(appState.detectStreamInfo.frameRate)) : 0; // sec
     AVPacket* packet = nullptr;
-    cv::Mat frame;
 
     MotionDetector detector;
+    detector.engine(appState.detector.engine);                         // segmentation engine
     detector.bgrSubThreshold(appState.detector.bgrSubThreshold);       // foreground / background gray difference
+    detector.minActiveCells(appState.detector.minActiveCells);         // cells, 0: by motion area
+    detector.minBlobArea(appState.detector.minBlobArea);               // per cent, 0: no blob filter
+    detector.maxBlobCount(appState.detector.maxBlobCount);             // blobs, 0: unlimited
+    detector.voteFrames(appState.detector.voteFrames);                 // masks voting, 1: disabled
+    detector.voteMinimum(appState.detector.voteMinimum);               // k of voteFrames
+    detector.minMotionArea(appState.detector.minMotionArea);           // per cent of analysed area
     detector.minMotionDuration(appState.detector.minMotionDuration);   // consecutive frames
-    detector.minMotionIntensity(appState.detector.minMotionIntensity); // pixels
-
+    detector.idleDelay(appState.detector.idleDelay);                   // update steps
+    detector.mvThreshold(appState.detector.mvThreshold);               // pixels per frame
+    detector.threads(appState.detector.threads);                       // stripes in parallel, 1: serial
+    detector.frameDuration(frameDuration);                             // durations by time stamps
+    detector.globalChangeArea(appState.detector.globalChangeArea);     // per cent, 0: disabled
+    detector.tamperDuration(appState.detector.tamperDuration);         // frames, 0: disabled
+    detector.seedFrames(appState.detector.seedFrames);                 // median seed after (re)connect
+    detector.warmUpFrames(appState.detector.warmUpFrames);             // learning rate decays to alpha
+    detector.suppressActivity(appState.detector.suppressActivity);     // fraction, 0: disabled
+    detector.suppressionTime(appState.detector.suppressionTime);       // frames
+    detector.cascadeThreshold(appState.detector.cascadeThreshold);     // gray levels, 0: no cascade
+    detector.cascadeTail(appState.detector.cascadeTail);               // frames
+    detector.cascadeRefresh(appState.detector.cascadeRefresh);         // frames
+    // roi in pixels of detection stream: lowres frames are already downscaled by 2^lowres,
+    // motion vector grid refers to stream size
+    int lowresScale = 1 << decoder.lowres();
+    cv::Rect roi = appState.detector.roi;
+    if (decoder.exportMotionVectors()) {
+        detector.motionInput(MotionInput::vectors);
+    } else {
+        roi = cv::Rect(roi.x / lowresScale, roi.y / lowresScale,
+                       roi.width / lowresScale, roi.height / lowresScale);
+    }
+    detector.roi(roi);
+    detector.scaleFrame(appState.detector.scaleFrame * lowresScale);
+    std::vector<MotionZone> zones = appState.detector.zones;
+    if (!decoder.exportMotionVectors()) {
+        for (MotionZone& zone : zones) {
+            for (cv::Point& point : zone.polygon)
+                point = cv::Point(point.x / lowresScale, point.y / lowresScale);
+        }
+    }
+    detector.zones(zones);
+    for (const MotionZone& zone : zones) {
+        std::cout << getTimeStampMs() << " Motion detection zone: " << zone.name
+                  << ", threshold: " << zone.bgrSubThreshold << ", area: " << zone.minMotionArea
+                  << " %, duration: " << zone.minMotionDuration << std::endl;
+    }
+    if (roi.area() > 0) {
+        std::cout << getTimeStampMs() << " Motion detection roi: " << appState.detector.roi
+                  << ", scale: " << appState.detector.scaleFrame << std::endl;
+    }
+    if (detector.engine() != EngineType::lowPass) {
+        std::cout << getTimeStampMs() << " Segmentation engine: " << engineName(detector.engine()) << std::endl;
+    }
+    if (detector.threads() > 1) {
+        std::cout << getTimeStampMs() << " Detection threads: " << detector.threads() << std::endl;
+    }
+    if (detector.cascadeThreshold() > 0 && !decoder.exportMotionVectors()) {
+        std::cout << getTimeStampMs() << " Cascade, coarse threshold: " << detector.cascadeThreshold()
+                  << ", tail: " << detector.cascadeTail() << ", refresh: " << detector.cascadeRefresh() << std::endl;
+    }
+    if (detector.minBlobArea() > 0) {
+        std::cout << getTimeStampMs() << " Blob filter, min. area: " << detector.minBlobArea()
+                  << " %, max. blobs: " << detector.maxBlobCount() << std::endl;
+    }
+    int decodedSincePublish = 0; // frames decoded since last published frame
     size_t npreIdxs = static_cast<size_t>(detector.minMotionDuration()) + 1;
     CircularBuffer<MotionDiagPic> diagBuffer(npreIdxs);
+    std::mutex diagMtx; // diag buffer: filled by detect stage, read by packet size trigger
+
+    // packet size pre-detector: wake idle detector or trigger w/o decoding all frames
+    PacketDetectorParams packetDetectorParams = appState.packet;
+    PacketDetector packetDetector;
+    packetDetector.alpha(packetDetectorParams.alpha);
+    packetDetector.minMotionDuration(detector.minMotionDuration());     // consecutive packets
+    packetDetector.threshold(packetDetectorParams.threshold);           // standard deviations
+    packetDetector.warmUp(packetDetectorParams.warmUp);                 // packets
+    bool wakePending = false; // waiting for key frame, if idle decoding skips references
+    if (packetDetectorParams.mode == PacketTrigger::wake) {
+        std::cout << getTimeStampMs() << " Packet size detector wakes motion detector, threshold: "
+                  << packetDetector.threshold() << std::endl;
+    } else if (packetDetectorParams.mode == PacketTrigger::trigger) {
+        decoder.decodeFrames(idleFrames);
+        std::cout << getTimeStampMs() << " Packet size detector triggers motion, threshold: "
+                  << packetDetector.threshold() << ", decode key/reference frames only" << std::endl;
+    }
+
+    // pipeline: decode stage (this thread) and detect stage connected by ring of frames
+    // frame N + 1 is decoded, while frame N is analysed, detect stage takes newest frame
+    // idle mode: detect stage requests frames to decode, packet size detector wakes it,
+    // request is valid, if detect stage has seen all wake requests
+    // request: wake requests seen (upper 32 bits) and frames to decode in one word,
+    // decode stage never combines frames of one request with wakes of another
+    FrameRing frameRing;
+    std::atomic_uint wakeRequests{0};
+    std::atomic<uint64_t> decodeRequest{static_cast<uint64_t>(decoder.decodeFrames())};
+    StageCounter decodeCounter, detectCounter;
+    auto lastReport = std::chrono::steady_clock::now();
+    const auto reportInterval = std::chrono::minutes(10);
+    // utilisation: stage close to 100 % is the bottleneck, detect stage drops frames
+    auto reportUtilisation = [&]() {
+        auto now = std::chrono::steady_clock::now();
+        double us = std::chrono::duration<double, std::micro>(now - lastReport).count();
+        lastReport = now;
+        long long decodeBusy = decodeCounter.takeBusy(), decodeCount = decodeCounter.takeCount();
+        long long detectBusy = detectCounter.takeBusy(), detectCount = detectCounter.takeCount();
+        std::cout << getTimeStampMs() << std::fixed << std::setprecision(1)
+                  << " Utilisation decode: " << 100 * decodeBusy / us << " % ("
+                  << (decodeCount ? decodeBusy / 1000.0 / decodeCount : 0) << " ms per step), detect: "
+                  << 100 * detectBusy / us << " % ("
+                  << (detectCount ? detectBusy / 1000.0 / detectCount : 0) << " ms per frame), frames dropped: "
+                  << frameRing.dropped() << std::defaultfloat << std::endl;
+    };
+
+    std::thread detectStage([&]() {
+        int framesSinceUpdate = 0; // frames since last motion detection update
+        unsigned streamGeneration = 0; // background seeded, when stream was (re)opened
+        unsigned wakesSeen = 0;
+        auto lastUpdate = std::chrono::steady_clock::now(); // of detector
+        bool isTamper = false;
+        int suppressedCells = 0;
+        cv::Mat frame;
+
+        // frame referenced by ring until next frame is taken
+        while (StageFrame* stageFrame = frameRing.take()) {
+            detectCounter.begin();
+            framesSinceUpdate += stageFrame->frameStep;
+
+            // retrieve frame or its motion vectors
+            if (detector.motionInput() == MotionInput::vectors) {
+                // intra frame: no motion vectors, keep motion state until next predicted frame
+                if (!frameMotionVectors(stageFrame->frame, frame, stageFrame->pastDistance,
+                                        stageFrame->futureDistance)) {
+                    detectCounter.end();
+                    continue;
+                }
+            } else if (!frameGrayImage(stageFrame->frame, frame)) {
+                std::cout << "Failed to retrieve frame for motion detection" << std::endl;
+                detectCounter.end();
+                continue;
+            }
+            DEBUG(getTimeStampMs() << " " << __func__ << " #" << __LINE__ << ", frame retrieved, time "  << stageFrame->timeStamp << " sec");
+
+            // woken by packet size detector
+            unsigned wakes = wakeRequests;
+            if (wakes != wakesSeen) {
+                detector.wake();
+                wakesSeen = wakes;
+            }
+
+            // detect motion
+            // stream (re)opened: background restored from state file (start) or kept (short
+            // interruption), else seeded from median of first frames
+            if (stageFrame->streamGeneration != streamGeneration) {
+                bool isStart = streamGeneration == 0;
+                streamGeneration = stageFrame->streamGeneration;
+                int interruption = static_cast<int>(std::chrono::duration_cast<std::chrono::seconds>(
+                                                        std::chrono::steady_clock::now() - lastUpdate).count());
+                if (isStart && !appState.detector.stateFile.empty()
+                        && detector.restoreState(appState.detector.stateFile, appState.detector.stateMaxAge)) {
+                    std::cout << getTimeStampMs() << " Background restored from "
+                              << appState.detector.stateFile << std::endl;
+                } else if (isStart || interruption > appState.detector.stateMaxAge) {
+                    detector.resetBackground();
+                    std::cout << getTimeStampMs() << " Background seeded from " << detector.seedFrames()
+                              << " frames, warm-up: " << detector.warmUpFrames() << " frames" << std::endl;
+                } else {
+                    std::cout << getTimeStampMs() << " Learned background kept, interruption: "
+                              << interruption << " sec" << std::endl;
+                }
+            }
+
+            // time stamp: motion duration independent of skipped or dropped frames
+            bool isMotion = detector.isContinuousMotion(frame, framesSinceUpdate, stageFrame->timeStamp);
+            framesSinceUpdate = 0;
+            lastUpdate = std::chrono::steady_clock::now();
+            if (detector.isGlobalChange()) {
+                std::cout << getTimeStampMs() << " Global change (illumination), background restarted" << std::endl;
+            }
+            if (detector.isTamper() != isTamper) {
+                isTamper = detector.isTamper();
+                std::cout << getTimeStampMs() << (isTamper ? " Camera tamper detected" : " Camera tamper cleared") << std::endl;
+            }
+            // learned suppression mask written for review, whenever it changes
+            if (detector.suppressedCells() != suppressedCells) {
+                suppressedCells = detector.suppressedCells();
+                std::cout << getTimeStampMs() << " Suppressed cells (permanent motion): " << suppressedCells << std::endl;
+                if (!appState.detector.suppressionImage.empty())
+                    detector.saveSuppressionMask(appState.detector.suppressionImage);
+            }
+
+            // idle: reduce decoding to key or reference frames, applied by decode stage
+            // packet size trigger: decoded frames needed for diag pics only
+            DecodeFrames requestFrames = detector.isIdle() || packetDetectorParams.mode == PacketTrigger::trigger
+                    ? idleFrames : DecodeFrames::all;
+            decodeRequest = static_cast<uint64_t>(wakesSeen) << 32 | static_cast<uint64_t>(requestFrames);
+
+            // buffer last frame for diagnostics
+            // TODO integrate into MotionDetector class
+            // slot of oldest sample reused: copy into its buffers, no allocation once ring is full
+            {
+                std::lock_guard<std::mutex> lock(diagMtx);
+                MotionDiagPic& sd = diagBuffer.pushInPlace();
+                detector.resizedFrame().copyTo(sd.frame);
+                detector.motionCells(sd.motion); // scaled to frame size, if diag pics are created
+                sd.motionDuration = detector.motionDuration();
+                sd.motionIntensity = detector.motionIntensity();
+                sd.packetScore = stageFrame->packetScore;
+
+                if (packetDetectorParams.mode != PacketTrigger::trigger) {
+                    signalMotion(isMotion, diagBuffer, appState);
+                }
+            }
+            detectCounter.end();
+
+            DEBUG(getTimeStampMs() << " " << __func__ << " #" << __LINE__ << ", motion detection finished");
+        }
+    });
 
 
     while (!appState.terminate) {
@@ -183,89 +618,166 @@ int detectMotion(PacketSafeQueue& packetQueue, State& appState)
         DEBUG(getTimeStampMs() << " " << __func__ << " #" << __LINE__ << ", new packet received");
         if (appState.terminate) break;
 
+        decodeCounter.begin();
         bool badDecode = false;
+        bool newFrame = false;
+        double packetScore = 0; // max. score of popped packets
         size_t queueSize = packetQueue.size();
 
+        // idle mode requested by detect stage, unless woken meanwhile
+        uint64_t request = decodeRequest;
+        DecodeFrames decodeFrames = static_cast<DecodeFrames>(request & 0xffffffff);
+        if (static_cast<unsigned>(request >> 32) == wakeRequests && decodeFrames != decoder.decodeFrames()) {
+            decoder.decodeFrames(decodeFrames);
+            std::cout << getTimeStampMs() << (decodeFrames == DecodeFrames::all
+                    ? " Motion detector active, decode all frames"
+                    : " Motion detector idle, decode key/reference frames only") << std::endl;
+        }
+
         while (packetQueue.pop(packet)) {
             DEBUG(getTimeStampMs() << " " << __func__ << " #" << __LINE__ << ", packet " << cntDecoded << " popped, pts: " << packet->pts << ", size: " << packet->size);
             if (appState.terminate) break;
-            // decode.startCount();
-            if ((badDecode = !decoder.decodePacket(packet))) {
+
+            // packet size pre-detector, before packet is decoded
+            if (packetDetectorParams.mode != PacketTrigger::off) {
+                bool isPacketMotion = packetDetector.apply(packet);
+                packetScore = packetDetector.score() > packetScore ? packetDetector.score() : packetScore;
+
+                // decoding all frames needs complete references:
+                // wake immediately, if only non-reference frames were skipped, else at next key frame
+                if (decoder.decodeFrames() == DecodeFrames::all) {
+                    wakePending = false;
+                } else if (packetDetectorParams.mode == PacketTrigger::wake) {
+                    wakePending = wakePending || isPacketMotion;
+                    if (wakePending && (decoder.decodeFrames() == DecodeFrames::reference
+                                        || packetDetector.isKeyFrame())) {
+                        decoder.decodeFrames(DecodeFrames::all);
+                        ++wakeRequests;
+                        wakePending = false;
+                        std::cout << getTimeStampMs() << " Packet size score " << packetDetector.score()
+                                  << ", motion detector active, decode all frames" << std::endl;
+                    }
+                }
+            }
+
+            if (decoder.decodePacket(packet)) {
+                newFrame = true;
+                badDecode = false;
+            } else if ((badDecode = decoder.hasDecodeError())) {
                 std::cout << "Failed to decode packet for motion detection" << std::endl;
             }
             queueSize = (packetQueue.size() > queueSize) ? packetQueue.size() : queueSize;
 
             DEBUG(getTimeStampMs() << " " << __func__ << " #" << __LINE__ << ", packet decoded, queueSize: " << packetQueue.size());
-            // decode.stopCount();
 
             av_packet_free(&packet);
+            ++decodedSincePublish;
+
+            // idle: analyze key frame immediately, so that decoding
+            // continues with the following packet when waking up
+            if (newFrame && decoder.decodeFrames() != DecodeFrames::all) break;
         }
 
         /* DEBUG */
         if (queueSize > 10) {
-            std::cout << getTimeStampMs() << " Queue of size: " << queueSize << " discharged at " << decoder.frameTime(appState.streamInfo.timeBase) << " sec" << std::endl;
+            std::cout << getTimeStampMs() << " Queue of size: " << queueSize << " discharged at " << decoder.frameTime(appState.detectStreamInfo.timeBase) << " sec" << std::endl;
         }
 
-        // skip motion detection for partly decoded frames
-        if (badDecode) continue;
+        // report decoder latency while it grows (frame threading warm-up), once per depth
+        if (decoder.frameDelay() > frameDelay) {
+            frameDelay = decoder.frameDelay();
+            std::cout << getTimeStampMs() << " Decoder delay: " << frameDelay << " frames ("
+                      << frameDelay * frameDuration * 1000 << " ms)" << std::endl;
+        }
 
-        // retrieve last frame
-        if (!decoder.retrieveFrame(frame)) {
-            std::cout << "Failed to retrieve frame for motion detection" << std::endl;
+        // packet size trigger: motion state independent of decoded frames
+        if (packetDetectorParams.mode == PacketTrigger::trigger) {
+            std::lock_guard<std::mutex> lock(diagMtx);
+            signalMotion(packetDetector.isContinuousMotion(), diagBuffer, appState);
         }
-        DEBUG(getTimeStampMs() << " " << __func__ << " #" << __LINE__ << ", frame retrieved, time "  << decoder.frameTime(appState.streamInfo.timeBase) << " sec");
-
-        // detect motion
-        // motion.startCount();
-        bool isMotion = detector.isContinuousMotion(frame);
-
-        // buffer last frame for diagnostics
-        // TODO integrate into MotionDetector class
-        MotionDiagPic sd;
-        sd.frame = detector.resizedFrame().clone();
-        sd.motion = detector.motionMask().clone();
-        sd.motionDuration = detector.motionDuration();
-        sd.motionIntensity = detector.motionIntensity();
-        diagBuffer.push(sd);
-
-        if (isMotion) {
-            if (!appState.motion.writeInProgress) {
-                std::cout << getTimeStampMs() << " START MOTION ---------" << std::endl;
-                if (appState.debug) createDiagPics(diagBuffer, appState.motionDiag);
-                {
-                    std::lock_guard<std::mutex> lock(appState.motion.startMtx);
-                    appState.motion.start = true;
-                    appState.motion.stop = false;
-                    // appState.motion.writeInProgress = true; // move to write motion packets thread
-                }
-                appState.motion.startCnd.notify_one();
-            }
-        } else {
-            if (!appState.motion.stop) {
-                std::cout<< getTimeStampMs() << " STOP MOTION ----------" << std::endl;
-                appState.motion.stop = true;
+
+        // hand over last frame to detect stage (reference, no copy)
+        // skip motion detection for partly decoded frames
+        // or if decoder did not return a frame yet (frame threading)
+        if (!badDecode && newFrame) {
+            StageFrame& stageFrame = frameRing.fill();
+            if (decoder.retrieveFrame(stageFrame.frame)) {
+                stageFrame.frameStep = decodedSincePublish;
+                stageFrame.futureDistance = decoder.futureRefDistance();
+                stageFrame.pastDistance = decoder.pastRefDistance();
+                stageFrame.packetScore = packetScore;
+                stageFrame.timeStamp = decoder.frameTime(appState.detectStreamInfo.timeBase);
+                stageFrame.streamGeneration = appState.streamGeneration;
+                frameRing.publish();
+                decodedSincePublish = 0;
+            } else {
+                std::cout << "Failed to retrieve frame for motion detection" << std::endl;
             }
         }
-        // motion.stopCount();
-
-        DEBUG(getTimeStampMs() << " " << __func__ << " #" << __LINE__ << ", motion detection finished");
+        decodeCounter.end();
 
-        // detect motion dummy
-        // std::this_thread::sleep_for(std::chrono::milliseconds(200));
-        // DEBUG(getTimeStampMs() << " " << __func__ << " #" << __LINE__ << ", motion detection finished");
+        if (std::chrono::steady_clock::now() - lastReport >= reportInterval) {
+            reportUtilisation();
+        }
     }
 
+    frameRing.terminate();
+    detectStage.join();
+    reportUtilisation();
+
+    // learned background for next start
+    if (!appState.detector.stateFile.empty() && detector.saveState(appState.detector.stateFile)) {
+        std::cout << getTimeStampMs() << " Background saved to " << appState.detector.stateFile << std::endl;
+    }
     decoder.close();
 
+    return 0;
+}
 
-    /* DEBUG
-    decode.printStatistics();
-    motion.printStatistics();
-    //decode.printAllSamples();
-    //motion.printAllSamples();
-    */
 
-    return 0;
+// "x,y x,y ..." -> points, malformed points are skipped
+std::vector<cv::Point> polygonFromString(const QString& text)
+{
+    std::vector<cv::Point> polygon;
+    const QStringList points = text.split(' ', Qt::SkipEmptyParts);
+    for (const QString& point : points) {
+        QStringList coords = point.split(',');
+        bool isX = false, isY = false;
+        if (coords.size() == 2) {
+            int x = coords.at(0).toInt(&isX);
+            int y = coords.at(1).toInt(&isY);
+            if (isX && isY)
+                polygon.push_back(cv::Point(x, y));
+        }
+    }
+    return polygon;
+}
+
+
+QString polygonToString(const std::vector<cv::Point>& polygon)
+{
+    QStringList points;
+    for (const cv::Point& point : polygon)
+        points.append(QString("%1,%2").arg(point.x).arg(point.y));
+    return points.join(' ');
+}
+
+
+// substream reader thread func -> read low resolution packets for motion detection
+bool processSubstream(LibavReader& reader, PacketSafeQueue& decodeQueue, State& appState)
+{
+    DEBUG(getTimeStampMs() << " " << __func__ << " #" << __LINE__<< ", thread read substream started");
+    AVPacket* packet = nullptr;
+    while (!appState.substreamStop && !appState.terminate) {
+        // free packet in detectMotion thread
+        if (!reader.readVideoPacket(packet)) {
+            std::cout << getTimeStampMs() << " Substream processing discontinued" << std::endl;
+            appState.substreamError = true;
+            return false;
+        }
+        decodeQueue.push(packet);
+    }
+    return true;
 }
 
 
@@ -286,18 +798,24 @@ bool processVideoStream(LibavReader& reader, PacketSafeQueue& decodeQueue, Packe
         //std::cout << "read packet " << cnt++ << ", pts: " << packet->pts << ", size: " << packet->size << std::endl;
         DEBUG(getTimeStampMs() << " " << __func__ << " #" << __LINE__<< ", packet read, pts: " << packetDecoder->pts );
 
-        // clone packet for pre-capture buffer
-        // free packetPreCaptureBuffer in writeMotionPackets thread
-        AVPacket* packetPreCaptureBuffer = av_packet_clone(packetDecoder);
-        if(!packetPreCaptureBuffer) {
-            std::cout << "nullptr packet motion buffer -> break" << std::endl;
-            break;
-        }
+        // substream: main stream is recorded only, not decoded
+        if (appState.useSubstream) {
+            preCaptureBuffer.push(packetDecoder);
+            if (appState.substreamError) break;
+        } else {
+            // clone packet for pre-capture buffer
+            // free packetPreCaptureBuffer in writeMotionPackets thread
+            AVPacket* packetPreCaptureBuffer = av_packet_clone(packetDecoder);
+            if(!packetPreCaptureBuffer) {
+                std::cout << "nullptr packet motion buffer -> break" << std::endl;
+                break;
+            }
 
-        decodeQueue.push(packetDecoder);
-        DEBUG(getTimeStampMs() << " " << __func__ << " #" << __LINE__ << ", packet pushed");
+            decodeQueue.push(packetDecoder);
+            DEBUG(getTimeStampMs() << " " << __func__ << " #" << __LINE__ << ", packet pushed");
 
-        preCaptureBuffer.push(packetPreCaptureBuffer);
+            preCaptureBuffer.push(packetPreCaptureBuffer);
+        }
 
         /* non-blocking getch
         // cannot run as background process if connected to terminal input
@@ -330,6 +848,29 @@ bool processVideoStream(LibavReader& reader, PacketSafeQueue& decodeQueue, Packe
 }
 
 
+void reopenReader(LibavReader& reader, const std::string& input)
+{
+    int ret = -1;
+    while (ret) {
+        ret = reader.open(input);
+
+        // keep trying to connect
+        // 2021-11-11 also for invalid data (for test purposes)
+        // if (ret == AVERROR(ETIMEDOUT) || ret == AVERROR(ENETUNREACH) || ret == AVERROR_INVALIDDATA) {
+        // keep trying to connect for all errors
+        if (ret < 0) {
+            int timeout = 30;
+            std::cout << getTimeStampMs() << " Open input error (" << ret
+                      << "), trying to re-connect in " << timeout << " sec" << std::endl;
+            std::this_thread::sleep_for(std::chrono::seconds(timeout));
+            continue;
+        }
+    }
+    std::cout << getTimeStampMs() << " Video input opened successfully: "
+              << input << std::endl;
+}
+
+
 void resetWriter(State& appState, WriteState& writeState, LibavWriter& writer)
 {
     if (writer.isOpen()) {
@@ -360,6 +901,49 @@ void sigHandler(int signum)
 }
 
 
+// notify write motion packets thread about start / stop of motion
+void signalMotion(bool isMotion, CircularBuffer<MotionDiagPic>& diagBuffer, State& appState)
+{
+    if (isMotion) {
+        if (!appState.motion.writeInProgress) {
+            std::cout << getTimeStampMs() << " START MOTION ---------" << std::endl;
+            if (appState.debug) createDiagPics(diagBuffer, appState.motionDiag);
+            {
+                std::lock_guard<std::mutex> lock(appState.motion.startMtx);
+                appState.motion.start = true;
+                appState.motion.stop = false;
+                // appState.motion.writeInProgress = true; // move to write motion packets thread
+            }
+            appState.motion.startCnd.notify_one();
+        }
+    } else {
+        if (!appState.motion.stop) {
+            std::cout<< getTimeStampMs() << " STOP MOTION ----------" << std::endl;
+            appState.motion.stop = true;
+        }
+    }
+}
+
+
+void startSubstream(LibavReader& reader, PacketSafeQueue& decodeQueue, State& appState)
+{
+    appState.substreamError = false;
+    appState.substreamStop = false;
+    appState.threadReadSubstream = std::thread(processSubstream, std::ref(reader),
+                                               std::ref(decodeQueue), std::ref(appState));
+}
+
+
+// blocks for max. rtsp timeout (5 sec), if substream stalls
+void stopSubstream(State& appState)
+{
+    appState.substreamStop = true;
+    if (appState.threadReadSubstream.joinable()) {
+        appState.threadReadSubstream.join();
+    }
+}
+
+
 void terminateThreads(PacketSafeQueue& packetQueue, PacketSafeCircularBuffer& buffer, State& appState)
 {
     rlutil::setColor(rlutil::RED);
@@ -370,6 +954,7 @@ void terminateThreads(PacketSafeQueue& packetQueue, PacketSafeCircularBuffer& bu
 
     std::cout << getTimeStampMs() << " Waiting for worker threads to join"
               << std::endl;
+    stopSubstream(appState);
     packetQueue.terminate();
     appState.threadMotionDetection.join();
     std::cout << getTimeStampMs() << " Motion detection thread joined" << std::endl;
@@ -566,6 +1151,9 @@ int main(int argc, char *argv[])
     cmdLine.addHelpOption();
     QCommandLineOption roiOption(QStringList() << "r" << "roi", "show roi before processing files");
     cmdLine.addOption(roiOption);
+    QCommandLineOption substreamOption(QStringList() << "s" << "substream",
+        "Detect motion on low resolution substream, record input video stream only", "rtsp://...");
+    cmdLine.addOption(substreamOption);
     cmdLine.addPositionalArgument("rtsp://...", "Input video stream");
 
     cmdLine.process(a);
@@ -592,22 +1180,88 @@ int main(int argc, char *argv[])
         std::cout << getTimeStampMs() << " Open video input: "  << inputStream << std::endl;
     }
 
+    // optional substream for motion detection, main stream is recorded only
+    std::string substream = cmdLine.value(substreamOption).toStdString();
+    LibavReader readerSubstream;
+    if (!substream.empty()) {
+        ret = readerSubstream.open(substream);
+        if (ret < 0) {
+            std::cout << getTimeStampMs() << " Error opening substream: " << substream << std::endl;
+            return -1;
+        } else {
+            std::cout << getTimeStampMs() << " Open substream for motion detection: "  << substream << std::endl;
+        }
+    }
+
     // prepare for motion detection thread
     // TODO refactor State as class with initializing valid state
     State appState;
 
     // foreground / background gray difference
+    appState.detector.engine = params.detector.engine;
     appState.detector.bgrSubThreshold = params.detector.bgrSubThreshold;
 
     // consecutive frames
     appState.detector.minMotionDuration = params.detector.minMotionDuration;
 
-    // pixels
-    appState.detector.minMotionIntensity = params.detector.minMotionIntensity;
+    // per cent of analysed area or number of active cells
+    appState.detector.minActiveCells = params.detector.minActiveCells;
+    appState.detector.minMotionArea = params.detector.minMotionArea;
+
+    // analysed region and its scale factor, zones within region
+    appState.detector.roi = params.detector.roi;
+    appState.detector.scaleFrame = params.detector.scaleFrame;
+    appState.detector.zones = params.detector.zones;
+
+    // stripes of detection in parallel, 1: serial
+    appState.detector.threads = params.detector.threads;
+
+    // illumination change restarts background, sustained whole-frame change: tamper
+    appState.detector.globalChangeArea = params.detector.globalChangeArea;
+    appState.detector.tamperDuration = params.detector.tamperDuration;
+
+    // background seed after (re)connect and learning rate warm-up
+    appState.detector.seedFrames = params.detector.seedFrames;
+    appState.detector.warmUpFrames = params.detector.warmUpFrames;
+
+    // learned background across restarts and reconnects
+    appState.detector.stateFile = params.detector.stateFile;
+    appState.detector.stateMaxAge = params.detector.stateMaxAge;
+
+    // coarse stage every frame, fine stage on activity only
+    appState.detector.cascadeRefresh = params.detector.cascadeRefresh;
+    appState.detector.cascadeTail = params.detector.cascadeTail;
+    appState.detector.cascadeThreshold = params.detector.cascadeThreshold;
+
+    // cells of permanent motion excluded from segmentation, mask image for review
+    appState.detector.suppressActivity = params.detector.suppressActivity;
+    appState.detector.suppressionImage = params.detector.suppressionImage;
+    appState.detector.suppressionTime = params.detector.suppressionTime;
+
+    // blob filter: minimum blob size, maximum number of blobs
+    appState.detector.maxBlobCount = params.detector.maxBlobCount;
+    appState.detector.minBlobArea = params.detector.minBlobArea;
+
+    // temporal voting: foreground in k of n masks
+    appState.detector.voteFrames = params.detector.voteFrames;
+    appState.detector.voteMinimum = params.detector.voteMinimum;
+
+    // motion vectors instead of pixels, pixels per frame
+    appState.detector.motionVectors = params.detector.motionVectors;
+    appState.detector.mvThreshold = params.detector.mvThreshold;
 
     // frames
     appState.detector.postCapture = params.detector.postCapture;
 
+    // update steps w/o motion before decoding key frames only
+    appState.detector.idleDelay = params.detector.idleDelay;
+
+    // multithreaded decoding
+    appState.decoder = params.decoder;
+
+    // packet size pre-detector
+    appState.packet = params.packet;
+
     appState.motion.start = false; // needs lock, if detection thread is already running
     appState.motion.stop = true;
     appState.motion.writeInProgress = false;
@@ -620,7 +1274,14 @@ int main(int argc, char *argv[])
         std::cout << getTimeStampMs() << "Failed to get video stream info" << std::endl;
         return -1;
     }
+    appState.useSubstream = !substream.empty();
+    appState.detectStreamInfo = appState.streamInfo;
+    if (appState.useSubstream && !readerSubstream.getVideoStreamInfo(appState.detectStreamInfo)) {
+        std::cout << getTimeStampMs() << "Failed to get substream info" << std::endl;
+        return -1;
+    }
     appState.errorCount = 0;
+    appState.streamGeneration = 0;
     appState.timeLastError = std::chrono::system_clock::now();
 
     PacketSafeQueue decodeQueue;
@@ -634,24 +1295,7 @@ int main(int argc, char *argv[])
     // reader.openPaused()
      while (!appState.terminate) {
         if (!reader.isOpen()) {
-            ret = -1;
-            while (ret) {
-                ret = reader.open(inputStream);
-
-                // keep trying to connect
-                // 2021-11-11 also for invalid data (for test purposes)
-                // if (ret == AVERROR(ETIMEDOUT) || ret == AVERROR(ENETUNREACH) || ret == AVERROR_INVALIDDATA) {
-                // keep trying to connect for all errors
-                if (ret < 0) {
-                    int timeout = 30;
-                    std::cout << getTimeStampMs() << " Open input error (" << ret
-                              << "), trying to re-connect in " << timeout << " sec" << std::endl;
-                    std::this_thread::sleep_for(std::chrono::seconds(timeout));
-                    continue;
-                }
-            }
-            std::cout << getTimeStampMs() << " Video input opened successfully: "
-                      << inputStream << std::endl;
+            reopenReader(reader, inputStream);
             if (!reader.getVideoStreamInfo(appState.streamInfo)) {
                 std::cout << getTimeStampMs() << " Failed to get video stream info"
                           << std::endl;
@@ -659,8 +1303,31 @@ int main(int argc, char *argv[])
                 return -1;
             }
         }
+        // detection thread seeds background with first frames of new connection
+        ++appState.streamGeneration;
+        if (appState.useSubstream) {
+            if (!readerSubstream.isOpen()) {
+                reopenReader(readerSubstream, substream);
+                if (!readerSubstream.getVideoStreamInfo(appState.detectStreamInfo)) {
+                    std::cout << getTimeStampMs() << " Failed to get substream info"
+                              << std::endl;
+                    terminateThreads(decodeQueue, preCaptureBuffer, appState);
+                    return -1;
+                }
+            }
+
+            // both streams are live, offset of stream start is covered by pre-capture buffer
+            int64_t startMain = reader.startTimeRealtime();
+            int64_t startSub = readerSubstream.startTimeRealtime();
+            if (startMain != AV_NOPTS_VALUE && startSub != AV_NOPTS_VALUE) {
+                std::cout << getTimeStampMs() << " Substream offset to main stream: "
+                          << (startSub - startMain) / 1000 << " ms" << std::endl;
+            }
+            startSubstream(readerSubstream, decodeQueue, appState);
+        }
         DEBUG(getTimeStampMs() << " " << __func__ << " #" << __LINE__<< ", reader open");
         processVideoStream(reader, decodeQueue, preCaptureBuffer, appState);   
+        stopSubstream(appState);
         if (appState.terminate) break;
 
         // reset state of threadMotionDetection and threadWritePackets
@@ -680,6 +1347,7 @@ int main(int argc, char *argv[])
         std::cout << getTimeStampMs() << " " << __func__ << " #" << __LINE__<< ", resetDone triggered" << std::endl;
 
         reader.close();
+        if (readerSubstream.isOpen()) readerSubstream.close();
         DEBUG(getTimeStampMs() << " " << __func__ << " #" << __LINE__<< ", reader closed");
         // DEBUG TODO DELETE
         std::cout << getTimeStampMs() << " " << __func__ << " #" << __LINE__<< ", reader closed" << std::endl;
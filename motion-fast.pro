@@ -12,9 +12,14 @@ DEFINES -= DEBUG_BUILD
 SOURCES += \
     avreadwrite.cpp \
     backgroundsubtraction.cpp \
+    detection-kernels.cpp \
+    detector-engines.cpp \
     motion-detector.cpp \
     motion-fast.cpp \
+    packet-detector.cpp \
     test/avreadwrite-test.cpp \
+    test/bench-detector.cpp \
+    test/decode-quality-test.cpp \
     test/show-diag-pics.cpp \
     time-stamp.cpp
 
@@ -45,10 +50,15 @@ HEADERS += \
     avreadwrite.h \
     backgroundsubtraction.h \
     circularbuffer.h \
+    detection-kernels.h \
+    detector-engines.h \
+    framering.h \
     motion-detector.h \
+    packet-detector.h \
     perfcounter.h \
     safebuffer.h \
-    time-stamp.h
+    time-stamp.h \
+    workerpool.h
 
 INSTALLS = target
 target.path = /home/pi
@@ -0,0 +1,142 @@
+#include "packet-detector.h"
+
+#include <cmath>
+
+
+PacketDetector::PacketDetector() :
+    m_alpha{0.02},              // approx. 50 packets time constant
+    m_baselineKey{0, 0, 0, {0}},
+    m_baselineNonKey{0, 0, 0, {0}},
+    m_isContinuousMotion{false},
+    m_isKeyFrame{false},
+    m_minMotionDuration{10},    // number of consecutive packets with motion
+    m_motionDuration{0},
+    m_score{0},
+    m_threshold{3.0},           // standard deviations
+    m_warmUp{25}                // packets per frame type
+{
+}
+
+
+void PacketDetector::alpha(double value)
+{
+    value = value > 1 ? 1 : value;
+    value = value <= 0 ? 0.001 : value;
+    m_alpha = value;
+}
+
+
+double PacketDetector::alpha() const
+{
+    return m_alpha;
+}
+
+
+bool PacketDetector::apply(const AVPacket* packet)
+{
+    m_isKeyFrame = packet->flags & AV_PKT_FLAG_KEY;
+    Baseline& base = m_isKeyFrame ? m_baselineKey : m_baselineNonKey;
+    double size = packet->size;
+    double delta = size - base.mean;
+
+    if (base.count < m_warmUp) {
+        // warm-up: cumulative mean and variance
+        ++base.count;
+        base.mean += delta / base.count;
+        base.variance += (delta * (size - base.mean) - base.variance) / base.count;
+        m_score = 0;
+    } else {
+        // lower bound of deviation: static scene produces almost constant packet sizes
+        double stdDev = std::sqrt(base.variance);
+        stdDev = stdDev < 0.05 * base.mean ? 0.05 * base.mean : stdDev;
+        stdDev = stdDev < 1 ? 1 : stdDev;
+        m_score = delta / stdDev;
+
+        // packets with motion adapt baseline slowly only (e.g. bitrate or night mode change)
+        double alpha = m_score > m_threshold ? m_alpha / 10 : m_alpha;
+        base.mean += alpha * delta;
+        base.variance = (1 - alpha) * (base.variance + alpha * delta * delta);
+    }
+    bool isMotion = m_score > m_threshold;
+
+    // update motion duration, same hysteresis as MotionDetector
+    if (isMotion) {
+        ++m_motionDuration;
+        m_motionDuration = m_motionDuration > m_minMotionDuration
+                ? m_minMotionDuration : m_motionDuration;
+    } else {
+        --m_motionDuration;
+        m_motionDuration = m_motionDuration <= 0
+                ? 0 : m_motionDuration;
+    }
+    if (m_motionDuration >= m_minMotionDuration) {
+        m_isContinuousMotion = true;
+    } else if (m_motionDuration == 0) {
+        m_isContinuousMotion = false;
+    }
+
+    return isMotion;
+}
+
+
+bool PacketDetector::isContinuousMotion() const
+{
+    return m_isContinuousMotion;
+}
+
+
+bool PacketDetector::isKeyFrame() const
+{
+    return m_isKeyFrame;
+}
+
+
+void PacketDetector::minMotionDuration(int value)
+{
+    /* allow 300 packets at max */
+    value = value > 300 ? 300 : value;
+    value = value < 0 ? 0 : value;
+    m_minMotionDuration = value;
+}
+
+
+int PacketDetector::minMotionDuration() const
+{
+    return m_minMotionDuration;
+}
+
+
+int PacketDetector::motionDuration() const
+{
+    return m_motionDuration;
+}
+
+
+double PacketDetector::score() const
+{
+    return m_score;
+}
+
+
+void PacketDetector::threshold(double value)
+{
+    m_threshold = value < 0 ? 0 : value;
+}
+
+
+double PacketDetector::threshold() const
+{
+    return m_threshold;
+}
+
+
+void PacketDetector::warmUp(int value)
+{
+    m_warmUp = value < 1 ? 1 : value;
+}
+
+
+int PacketDetector::warmUp() const
+{
+    return m_warmUp;
+}
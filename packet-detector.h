@@ -0,0 +1,72 @@
+#ifndef PACKETDETECTOR_H
+#define PACKETDETECTOR_H
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+/* off:     packet sizes not evaluated
+ * wake:    packet motion wakes idle pixel detector (decode all frames)
+ * trigger: packet motion alone starts recording, decoding of idle frames only */
+enum class PacketTrigger {off, wake, trigger};
+
+
+// CLASSES
+struct PacketDetectorParams
+{
+    double          alpha;
+    double          threshold;
+    int             warmUp;
+    PacketTrigger   mode;
+};
+
+
+/// pre-detector: compressed size of packet compared with rolling baseline
+/// of same frame type (key / non-key), w/o decoding
+/// predicted frames of a static scene are tiny, motion enlarges them
+class PacketDetector
+{
+public:
+    PacketDetector();
+    /* weight of new packet size in rolling baseline (exponential moving average) */
+    void        alpha(double value);
+    double      alpha() const;
+    /* update baseline with packet size
+     * true: score of packet exceeds threshold */
+    bool        apply(const AVPacket* packet);
+    bool        isContinuousMotion() const;
+    bool        isKeyFrame() const;
+    /* duration as number of packets */
+    void        minMotionDuration(int value);
+    int         minMotionDuration() const;
+    int         motionDuration() const;
+    /* deviation of last packet size from baseline in standard deviations
+     * 0 during warm-up */
+    double      score() const;
+    void        threshold(double value);
+    double      threshold() const;
+    /* number of packets per frame type before baseline is valid */
+    void        warmUp(int value);
+    int         warmUp() const;
+private:
+    struct Baseline
+    {
+        double  mean;
+        double  variance;
+        int     count;
+        char    avoidPaddingWarning1[4];
+    };
+    double      m_alpha;
+    Baseline    m_baselineKey;
+    Baseline    m_baselineNonKey;
+    bool        m_isContinuousMotion;
+    bool        m_isKeyFrame;
+    int         m_minMotionDuration;
+    int         m_motionDuration;
+    double      m_score;
+    double      m_threshold;
+    int         m_warmUp;
+};
+
+
+#endif // PACKETDETECTOR_H
@@ -2,6 +2,7 @@
 #define PERFCOUNTER_H
 
 #include <algorithm> // max_element
+#include <atomic>
 #include <chrono>
 #include <cmath>
 #include <iostream>
@@ -73,4 +74,41 @@ private:
     TimePoint               m_stop;
 };
 
+/// busy time of pipeline stage: utilisation = busy time / wall time of report interval
+/// begin, end: called by stage thread, take: by any thread (report)
+class StageCounter
+{
+public:
+    StageCounter() : m_busyUs(0), m_count(0) {}
+
+    void begin()
+    {
+        m_begin = std::chrono::steady_clock::now();
+    }
+
+    void end()
+    {
+        m_busyUs += std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - m_begin).count();
+        ++m_count;
+    }
+
+    /* busy microseconds since last call, counter restarts */
+    long long takeBusy()
+    {
+        return m_busyUs.exchange(0);
+    }
+
+    /* busy periods (e.g. frames) since last call, counter restarts */
+    long long takeCount()
+    {
+        return m_count.exchange(0);
+    }
+
+private:
+    std::chrono::steady_clock::time_point m_begin;
+    std::atomic<long long>  m_busyUs;
+    std::atomic<long long>  m_count;
+};
+
 #endif // PERFCOUNTER_H
@@ -0,0 +1,525 @@
+#include "../backgroundsubtraction.h"
+#include "../detection-kernels.h"
+#include "../detector-engines.h"
+#include "../motion-detector.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <iterator> // size
+#include <random>
+
+
+// reference: background subtraction by separate opencv passes (before fusion)
+int lowPassSegmentReference(const cv::Mat& image, cv::Mat& accu, cv::Mat& mask, double alpha, double threshold)
+{
+    cv::accumulateWeighted(image, accu, alpha);
+    cv::Mat accu8U;
+    cv::convertScaleAbs(accu, accu8U);
+    cv::absdiff(image, accu8U, mask);
+    cv::threshold(mask, mask, threshold, UCHAR_MAX, cv::THRESH_BINARY);
+    return cv::countNonZero(mask);
+}
+
+
+// synthetic gray frame: static gradient with noise, moving bright rectangle
+void createFrame(cv::Size size, int n, cv::Mat& frame)
+{
+    static cv::Mat background;
+    if (background.size() != size) {
+        background.create(size, CV_8UC1);
+        for (int row = 0; row < size.height; ++row) {
+            background.row(row).setTo(cv::Scalar(40 + 160 * row / size.height));
+        }
+    }
+    cv::Mat noise(size, CV_8UC1);
+    cv::randu(noise, cv::Scalar(0), cv::Scalar(8));
+    cv::add(background, noise, frame);
+    int width = size.width / 8;
+    int x = (n * size.width / 100) % (size.width - width);
+    cv::rectangle(frame, cv::Rect(x, size.height / 3, width, size.height / 3), cv::Scalar(230), cv::FILLED);
+}
+
+
+// pre-processing of fleet geometries: resize and blur (opencv) vs. area downscale and blur
+// (fused, generic and specialised for fixed geometry)
+void benchPreprocessing(int frames, const SimdPath paths[], size_t nPaths)
+{
+    for (cv::Size size : {cv::Size(1920, 1080), cv::Size(2560, 1440)}) {
+        for (int factor : {4, 2}) {
+            std::cout << "===================================" << std::endl
+                      << "pre-processing " << size.width << "x" << size.height << " / " << factor << std::endl;
+            cv::Mat frame, resized, blurred, pooled, pooledBlurred, area, areaBlurred;
+            int kernel = size.width / factor / 96;
+            double usRef = 0;
+            std::vector<double> usFused(nPaths, 0), usFixed(nPaths, 0);
+            std::vector<long> mismatches(nPaths, 0), mismatchesFixed(nPaths, 0), mismatchesBlur(nPaths, 0);
+            std::vector<double> deviationBlur(nPaths, 0);
+            cv::Mat pooledFixed, blurredFixed;
+
+            for (int n = 1; n <= frames; ++n) {
+                createFrame(size, n, frame);
+                auto start = std::chrono::steady_clock::now();
+                cv::resize(frame, resized, cv::Size(), 1.0 / factor, 1.0 / factor, cv::INTER_LINEAR);
+                cv::blur(resized, blurred, cv::Size(kernel, kernel));
+                usRef += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+                // pooling must match area interpolation, blur may differ at exact halves
+                cv::resize(frame, area, cv::Size(), 1.0 / factor, 1.0 / factor, cv::INTER_AREA);
+                cv::blur(area, areaBlurred, cv::Size(kernel, kernel));
+                for (size_t k = 0; k < nPaths; ++k) {
+                    if (!isSimdPathSupported(paths[k])) continue;
+                    start = std::chrono::steady_clock::now();
+                    poolBlur(frame.ptr<uchar>(), frame.step, frame.size(), factor, kernel, pooled, pooledBlurred, paths[k]);
+                    usFused[k] += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+                    if (cv::norm(pooled, area, cv::NORM_INF) != 0)
+                        ++mismatches[k];
+                    double deviation = cv::norm(pooledBlurred, areaBlurred, cv::NORM_INF);
+                    mismatchesBlur[k] += deviation != 0 ? 1 : 0;
+                    deviationBlur[k] = std::max(deviationBlur[k], deviation);
+
+                    // fixed geometry: must equal generic kernel
+                    start = std::chrono::steady_clock::now();
+                    poolBlurFixed(frame.ptr<uchar>(), frame.step, frame.size(), factor, kernel, pooledFixed, blurredFixed, paths[k]);
+                    usFixed[k] += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+                    if (cv::norm(pooledFixed, pooled, cv::NORM_INF) != 0
+                            || cv::norm(blurredFixed, pooledBlurred, cv::NORM_INF) != 0)
+                        ++mismatchesFixed[k];
+                }
+            }
+
+            std::cout << std::fixed << std::setprecision(1)
+                      << "resize linear + blur: " << usRef / frames << " us" << std::endl;
+            for (size_t k = 0; k < nPaths; ++k) {
+                if (!isSimdPathSupported(paths[k])) continue;
+                std::cout << "pool + blur " << std::setw(6) << simdPathName(paths[k]) << ": "
+                          << usFused[k] / frames << " us, speedup: " << std::setprecision(2)
+                          << usRef / usFused[k] << std::setprecision(1)
+                          << ", frames differing from INTER_AREA: " << mismatches[k]
+                          << ", from blur: " << mismatchesBlur[k] << " (max. " << deviationBlur[k]
+                          << " gray levels)" << std::endl;
+            }
+            for (size_t k = 0; k < nPaths; ++k) {
+                if (!isSimdPathSupported(paths[k])) continue;
+                std::cout << "fixed       " << std::setw(6) << simdPathName(paths[k]) << ": "
+                          << usFixed[k] / frames << " us, speedup: " << std::setprecision(2)
+                          << usRef / usFixed[k] << ", vs. generic: " << usFused[k] / usFixed[k]
+                          << std::setprecision(1) << ", frames differing from generic: "
+                          << mismatchesFixed[k] << std::endl;
+            }
+        }
+    }
+}
+
+
+// steady state of detection hot path: detector and diag ring buffer must not allocate
+// counts cv::Mat allocations (opencv built with allocator statistics, default)
+void benchAllocations(int frames)
+{
+    std::cout << "===================================" << std::endl
+              << "allocations per frame after warm-up" << std::endl;
+    cv::Size size(1920, 1080);
+    cv::utils::AllocatorStatisticsInterface& stats = cv::getAllocatorStatistics();
+    for (bool isZones : {false, true}) {
+        MotionDetector detector;
+        detector.minActiveCells(4);
+        if (isZones) {
+            MotionZone zone{};
+            zone.name = "left";
+            zone.polygon = {cv::Point(0, 0), cv::Point(960, 0), cv::Point(960, 1080), cv::Point(0, 1080)};
+            zone.bgrSubThreshold = 30;
+            zone.minMotionArea = 1;
+            zone.minMotionDuration = 10;
+            detector.zones({zone});
+        }
+        CircularBuffer<MotionDiagPic> diagBuffer(11);
+        cv::Mat frame;
+        // warm-up: background initialized, zones rasterized, ring buffer filled
+        const int warmUp = 20;
+        long long allocations = 0;
+        for (int n = 0; n < warmUp + frames; ++n) {
+            createFrame(size, n, frame);
+            long long before = stats.getNumberOfAllocations();
+            detector.isContinuousMotion(frame);
+            MotionDiagPic& sd = diagBuffer.pushInPlace();
+            detector.resizedFrame().copyTo(sd.frame);
+            detector.motionCells(sd.motion);
+            if (n >= warmUp)
+                allocations += stats.getNumberOfAllocations() - before;
+        }
+        std::cout << (isZones ? "zones:      " : "whole frame:") << " " << std::setprecision(2)
+                  << static_cast<double>(allocations) / frames << " (" << allocations << " in "
+                  << frames << " frames)" << std::endl;
+    }
+}
+
+
+// segmentation engines on same frames: clip (gray, scaled to 480 pixels width) or synthetic
+void benchEngines(int frames, const std::string& clip)
+{
+    std::vector<cv::Mat> input;
+    cv::Mat frame, gray;
+    cv::VideoCapture capture;
+    if (!clip.empty() && !capture.open(clip))
+        std::cout << "cannot open clip " << clip << ", synthetic frames used" << std::endl;
+    for (int n = 0; n < frames; ++n) {
+        if (capture.isOpened()) {
+            if (!capture.read(frame))
+                break;
+            cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+            double scale = 480.0 / gray.cols;
+            cv::resize(gray, frame, cv::Size(), scale, scale, cv::INTER_AREA);
+        } else {
+            createFrame(cv::Size(480, 270), n, frame);
+        }
+        input.push_back(frame.clone());
+    }
+    if (input.empty())
+        return;
+
+    std::cout << "===================================" << std::endl
+              << "engines " << input[0].cols << "x" << input[0].rows << ", frames: " << input.size()
+              << (capture.isOpened() ? ", clip: " + clip : std::string(", synthetic")) << std::endl;
+    for (EngineType type : {EngineType::lowPass, EngineType::runningAverage,
+                            EngineType::frameDiff, EngineType::mog2}) {
+        DetectorEngine engine = createDetectorEngine(type, 0.005, 50);
+        cv::Mat mask;
+        double us = 0;
+        long foreground = 0;
+        for (const cv::Mat& image : input) {
+            auto start = std::chrono::steady_clock::now();
+            foreground += std::visit([&](auto& e) { return e.apply(image, mask); }, engine);
+            us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        }
+        std::cout << std::setw(15) << engineName(type) << ": " << std::fixed << std::setprecision(1)
+                  << us / input.size() << " us, foreground: "
+                  << static_cast<double>(foreground) / input.size() << " pixels per frame" << std::endl;
+    }
+}
+
+
+// stripe-parallel detection of full HD frame scaled by 0.5 (zones and cells on)
+// time per frame of downscale, blur and segmentation, results must equal 1 thread
+void benchStripes(int frames)
+{
+    std::cout << "===================================" << std::endl
+              << "stripes 1920x1080 / 2, frames: " << frames << std::endl;
+    cv::Size size(1920, 1080);
+    MotionZone zone{};
+    zone.name = "left";
+    zone.polygon = {cv::Point(0, 0), cv::Point(960, 0), cv::Point(960, 1080), cv::Point(0, 1080)};
+    zone.bgrSubThreshold = 30;
+    zone.minMotionArea = 1;
+    zone.minMotionDuration = 10;
+
+    std::vector<MotionDetector> detectors(4);
+    std::vector<double> us(detectors.size(), 0);
+    std::vector<long> mismatches(detectors.size(), 0);
+    for (size_t k = 0; k < detectors.size(); ++k) {
+        detectors[k].scaleFrame(0.5);
+        detectors[k].zones({zone});
+        detectors[k].threads(static_cast<int>(k) + 1);
+    }
+
+    cv::Mat frame;
+    for (int n = 0; n < frames; ++n) {
+        createFrame(size, n, frame);
+        for (size_t k = 0; k < detectors.size(); ++k) {
+            auto start = std::chrono::steady_clock::now();
+            detectors[k].isContinuousMotion(frame);
+            us[k] += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            if (detectors[k].motionIntensity() != detectors[0].motionIntensity()
+                    || cv::norm(detectors[k].motionMask(), detectors[0].motionMask(), cv::NORM_INF) != 0
+                    || cv::norm(detectors[k].processedFrame(), detectors[0].processedFrame(), cv::NORM_INF) != 0) {
+                ++mismatches[k];
+            }
+        }
+    }
+
+    for (size_t k = 0; k < detectors.size(); ++k) {
+        std::cout << "threads " << detectors[k].threads() << ": " << std::fixed << std::setprecision(1)
+                  << us[k] / frames << " us, speedup: " << std::setprecision(2) << us[0] / us[k]
+                  << ", frames differing from 1 thread: " << mismatches[k] << std::endl;
+    }
+}
+
+
+// cascade: full HD frame scaled by 0.25, static scene for 80 % of frames, then moving object
+// time per frame with and without cascade, share of fine stage, frame of first motion
+void benchCascade(int frames)
+{
+    std::cout << "===================================" << std::endl
+              << "cascade 1920x1080 / 4, frames: " << frames << std::endl;
+    cv::Size size(1920, 1080);
+    const int motionStart = frames * 4 / 5;
+
+    std::vector<MotionDetector> detectors(2);
+    detectors[1].cascadeThreshold(8);
+    std::vector<double> us(detectors.size(), 0);
+    std::vector<int> fineSteps(detectors.size(), 0);
+    std::vector<int> firstMotion(detectors.size(), -1);
+
+    cv::Mat frame;
+    for (int n = 0; n < frames; ++n) {
+        createFrame(size, n < motionStart ? 0 : n - motionStart, frame);
+        for (size_t k = 0; k < detectors.size(); ++k) {
+            auto start = std::chrono::steady_clock::now();
+            bool isMotion = detectors[k].hasFrameMotion(frame);
+            us[k] += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            fineSteps[k] += detectors[k].isCoarseOnly() ? 0 : 1;
+            if (isMotion && n >= motionStart && firstMotion[k] < 0)
+                firstMotion[k] = n - motionStart;
+        }
+    }
+
+    for (size_t k = 0; k < detectors.size(); ++k) {
+        std::cout << (k == 0 ? "fine only: " : "cascade:   ") << std::fixed << std::setprecision(1)
+                  << us[k] / frames << " us, fine stage: " << 100.0 * fineSteps[k] / frames
+                  << " %, first motion at frame: " << firstMotion[k] << std::endl;
+    }
+}
+
+
+// packed masks on random masks against per pixel reference: packMask of each simd path,
+// popcountMask (with and w/o select), countPackedCells, voteMasks (k of n)
+// random widths (mostly not multiple of 64: padding bits), cell sizes (odd cell counts)
+void benchPackedMasks(int rounds, const SimdPath paths[], size_t nPaths)
+{
+    std::cout << "===================================" << std::endl
+              << "packed masks vs. per pixel reference, random masks, rounds: " << rounds << std::endl;
+    std::mt19937 rng(7);
+    auto uniform = [&rng](int low, int high) { return std::uniform_int_distribution<int>(low, high)(rng); };
+    std::vector<long> mismatchesPack(nPaths, 0);
+    long mismatchesPopcount = 0, mismatchesCells = 0, mismatchesVote = 0;
+
+    for (int round = 0; round < rounds; ++round) {
+        const int width = uniform(1, 700);
+        const int height = uniform(1, 40);
+        const int cellSize = uniform(1, 24);
+        const int frames = uniform(1, 9);
+        const int votes = uniform(1, frames);
+        const int density = uniform(0, 100); // per cent of foreground pixels
+        const int words = (width + 63) / 64;
+
+        // masks: msb is foreground, lower bits random; reference packed by pixel
+        std::vector<cv::Mat> masks(static_cast<size_t>(frames)), refs(static_cast<size_t>(frames));
+        cv::Mat history(frames * height, words * 8, CV_8UC1);
+        for (size_t f = 0; f < masks.size(); ++f) {
+            masks[f].create(height, width, CV_8UC1);
+            refs[f] = cv::Mat::zeros(height, words * 8, CV_8UC1);
+            for (int row = 0; row < height; ++row) {
+                uchar* src = masks[f].ptr<uchar>(row);
+                uint64_t* ref = refs[f].ptr<uint64_t>(row);
+                for (int x = 0; x < width; ++x) {
+                    bool isSet = uniform(0, 99) < density;
+                    src[x] = static_cast<uchar>(uniform(0, 127) | (isSet ? 128 : 0));
+                    ref[x / 64] |= static_cast<uint64_t>(isSet) << (x % 64);
+                }
+            }
+            refs[f].copyTo(history.rowRange(static_cast<int>(f) * height, (static_cast<int>(f) + 1) * height));
+        }
+
+        cv::Mat packed;
+        for (size_t k = 0; k < nPaths; ++k) {
+            if (!isSimdPathSupported(paths[k])) continue;
+            packMask(masks[0], packed, paths[k]);
+            if (packed.size() != refs[0].size() || cv::norm(packed, refs[0], cv::NORM_INF) != 0)
+                ++mismatchesPack[k];
+        }
+
+        // reference counts per pixel: foreground, selected, cells, votes
+        const cv::Mat& select = refs[masks.size() - 1];
+        int count = 0, selected = 0;
+        cv::Mat cells = cv::Mat::zeros((height + cellSize - 1) / cellSize, (width + cellSize - 1) / cellSize, CV_32S);
+        cv::Mat voted = cv::Mat::zeros(height, words * 8, CV_8UC1);
+        for (int row = 0; row < height; ++row) {
+            for (int x = 0; x < width; ++x) {
+                auto bit = [&](const cv::Mat& packedMask) {
+                    return (packedMask.ptr<uint64_t>(row)[x / 64] >> (x % 64)) & 1;
+                };
+                bool isSet = bit(refs[0]);
+                count += isSet;
+                selected += isSet && bit(select);
+                cells.at<int>(row / cellSize, x / cellSize) += isSet;
+                int n = 0;
+                for (const cv::Mat& ref : refs)
+                    n += static_cast<int>(bit(ref));
+                if (n >= votes)
+                    voted.ptr<uint64_t>(row)[x / 64] |= uint64_t(1) << (x % 64);
+            }
+        }
+
+        if (popcountMask(refs[0]) != count || popcountMask(refs[0], select) != selected)
+            ++mismatchesPopcount;
+        cv::Mat packedCells;
+        countPackedCells(refs[0], width, cellSize, packedCells);
+        if (packedCells.size() != cells.size() || cv::norm(packedCells, cells, cv::NORM_INF) != 0)
+            ++mismatchesCells;
+        cv::Mat packedVoted;
+        voteMasks(history, frames, votes, packedVoted);
+        if (packedVoted.size() != voted.size() || cv::norm(packedVoted, voted, cv::NORM_INF) != 0)
+            ++mismatchesVote;
+    }
+
+    for (size_t k = 0; k < nPaths; ++k) {
+        if (!isSimdPathSupported(paths[k])) continue;
+        std::cout << "packMask " << std::setw(6) << simdPathName(paths[k])
+                  << ": rounds differing from reference: " << mismatchesPack[k] << std::endl;
+    }
+    std::cout << "popcountMask:     rounds differing from reference: " << mismatchesPopcount << std::endl
+              << "countPackedCells: rounds differing from reference: " << mismatchesCells << std::endl
+              << "voteMasks:        rounds differing from reference: " << mismatchesVote << std::endl;
+}
+
+
+// global change on static scene, each engine
+// luminance step (exposure jump): background restarts, frames with motion after step must be 0
+// object close to camera (dark, 3/4 of frame): no global change, motion
+void benchGlobalChange(int frames)
+{
+    cv::Size size(1920, 1080);
+    const int step = frames / 2;
+    for (bool isObject : {false, true}) {
+        std::cout << "===================================" << std::endl << "global change 1920x1080 / 4, "
+                  << (isObject ? "close object" : "luminance step +40") << ", frames: " << frames << std::endl;
+        for (EngineType type : {EngineType::lowPass, EngineType::runningAverage,
+                                EngineType::frameDiff, EngineType::mog2}) {
+            MotionDetector detector;
+            detector.engine(type);
+            detector.scaleFrame(0.25);
+            int changes = 0, motionFrames = 0;
+            cv::Mat frame;
+            for (int n = 0; n < frames; ++n) {
+                createFrame(size, 0, frame);
+                if (n >= step && isObject)
+                    cv::rectangle(frame, cv::Rect(0, 0, size.width * 3 / 4, size.height), cv::Scalar(10), cv::FILLED);
+                else if (n >= step)
+                    frame.convertTo(frame, -1, 1, 40);
+                bool isMotion = detector.hasFrameMotion(frame);
+                if (n >= step) {
+                    changes += detector.isGlobalChange() ? 1 : 0;
+                    motionFrames += isMotion ? 1 : 0;
+                }
+            }
+            std::cout << std::setw(15) << engineName(type) << ": global changes: " << changes
+                      << ", frames with motion after step: " << motionFrames << std::endl;
+        }
+    }
+}
+
+
+// compare fused kernels with opencv reference at detection frame sizes
+// (1920x1080 scaled by 0.25 and 0.5), runtime per frame and bit exactness
+// fixed point Q8.8 model: runtime and deviation from float model
+// pre-processing: resize and blur vs. fused area downscale and blur (generic, fixed geometry)
+// allocations per frame of detector in steady state
+// engines: cost per frame on same frames, argv[2]: clip (optional)
+// stripes: detection of high resolution frame with 1 ... 4 threads
+// cascade: coarse stage for static frames
+// global change: luminance step and close object through each engine
+// packed masks: simd paths and bit kernels against per pixel reference
+int main_bench_detector(int argc, char *argv[])
+{
+    int frames = argc > 1 ? std::stoi(argv[1]) : 500;
+    const double alpha = 0.005;
+    const int alphaShift = 8; // 1/256
+    const double threshold = 50;
+    const SimdPath paths[] = {SimdPath::scalar, SimdPath::sse2, SimdPath::avx2, SimdPath::neon};
+
+    for (cv::Size size : {cv::Size(480, 270), cv::Size(960, 540)}) {
+        std::cout << "===================================" << std::endl
+                  << "frame size: " << size.width << "x" << size.height
+                  << ", frames: " << frames << std::endl;
+
+        cv::Mat frame;
+        createFrame(size, 0, frame);
+        cv::Mat accuRef;
+        frame.convertTo(accuRef, CV_32F);
+        cv::Mat maskRef;
+
+        // one accumulator per kernel, started with same background
+        std::vector<cv::Mat> accus, masks, accusQ8, masksQ8;
+        std::vector<double> usFused, usQ8;
+        std::vector<long> mismatches, mismatchesQ8;
+        cv::Mat accuQ8;
+        frame.convertTo(accuQ8, CV_16U, 256);
+        for (size_t n = 0; n < std::size(paths); ++n) {
+            accus.push_back(accuRef.clone());
+            masks.push_back(cv::Mat());
+            usFused.push_back(0);
+            mismatches.push_back(0);
+            accusQ8.push_back(accuQ8.clone());
+            masksQ8.push_back(cv::Mat());
+            usQ8.push_back(0);
+            mismatchesQ8.push_back(0);
+        }
+        double usRef = 0;
+        double maskDeviation = 0, countDeviation = 0; // Q8.8 vs. float
+
+        for (int n = 1; n <= frames; ++n) {
+            createFrame(size, n, frame);
+
+            auto start = std::chrono::steady_clock::now();
+            int countRef = lowPassSegmentReference(frame, accuRef, maskRef, alpha, threshold);
+            usRef += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+            for (size_t k = 0; k < std::size(paths); ++k) {
+                if (!isSimdPathSupported(paths[k])) continue;
+                start = std::chrono::steady_clock::now();
+                int count = lowPassSegment(frame, accus[k], masks[k], alpha, threshold, paths[k]);
+                usFused[k] += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+                if (count != countRef || cv::norm(accus[k], accuRef, cv::NORM_INF) != 0
+                        || cv::norm(masks[k], maskRef, cv::NORM_INF) != 0) {
+                    ++mismatches[k];
+                }
+
+                // fixed point: integer only, all paths identical to scalar
+                start = std::chrono::steady_clock::now();
+                int countQ8 = lowPassSegmentQ8(frame, accusQ8[k], masksQ8[k], alphaShift, threshold, paths[k]);
+                usQ8[k] += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+                if (cv::norm(accusQ8[k], accusQ8[0], cv::NORM_INF) != 0
+                        || cv::norm(masksQ8[k], masksQ8[0], cv::NORM_INF) != 0) {
+                    ++mismatchesQ8[k];
+                }
+                if (k == 0) {
+                    maskDeviation += cv::norm(masksQ8[0], maskRef, cv::NORM_L1) / UCHAR_MAX / frame.total();
+                    countDeviation += std::abs(countQ8 - countRef);
+                }
+            }
+        }
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << "opencv reference: " << usRef / frames << " us" << std::endl;
+        for (size_t k = 0; k < std::size(paths); ++k) {
+            if (!isSimdPathSupported(paths[k])) continue;
+            std::cout << "fused " << std::setw(6) << simdPathName(paths[k]) << ": "
+                      << usFused[k] / frames << " us, speedup: " << std::setprecision(2)
+                      << usRef / usFused[k] << std::setprecision(1)
+                      << ", frames not bit exact: " << mismatches[k] << std::endl;
+        }
+        for (size_t k = 0; k < std::size(paths); ++k) {
+            if (!isSimdPathSupported(paths[k])) continue;
+            std::cout << "Q8.8  " << std::setw(6) << simdPathName(paths[k]) << ": "
+                      << usQ8[k] / frames << " us, speedup: " << std::setprecision(2)
+                      << usRef / usQ8[k] << std::setprecision(1)
+                      << ", frames differing from scalar: " << mismatchesQ8[k] << std::endl;
+        }
+        std::cout << "Q8.8 vs. float: mask pixels differing: " << std::setprecision(3)
+                  << 100 * maskDeviation / frames << " %, foreground count diff: "
+                  << std::setprecision(1) << countDeviation / frames << " pixels" << std::endl;
+    }
+
+    benchPreprocessing(frames / 5, paths, std::size(paths));
+    benchAllocations(frames / 5);
+    benchEngines(frames, argc > 2 ? argv[2] : "");
+    benchStripes(frames / 5);
+    benchCascade(frames);
+    benchGlobalChange(frames / 5);
+    benchPackedMasks(frames, paths, std::size(paths));
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include "../avreadwrite.h"
+#include "../motion-detector.h"
+#include "../perfcounter.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <iostream>
+
+
+// decode recorded clip with full and detection quality in lockstep
+// compare decoding time and quality of the frames used for motion detection
+int main_decode_quality_test(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::cout << "usage: decode-quality-test videofile.mp4 [lowres]" << std::endl;
+        return -1;
+    }
+    int lowres = argc > 2 ? std::stoi(argv[2]) : 1;
+
+    LibavReader reader;
+    reader.init();
+    int ret = reader.open(argv[1]);
+    if (ret < 0) {
+        std::cout << "Error opening input: " << argv[1] << std::endl;
+        return -1;
+    }
+    VideoStream streamInfo;
+    if (!reader.getVideoStreamInfo(streamInfo)) {
+        std::cout << "Failed to get video stream info" << std::endl;
+        return -2;
+    }
+
+    LibavDecoder decoderFull;
+    LibavDecoder decoderDetect;
+    decoderDetect.quality(DecodeQuality::detection);
+    decoderDetect.lowres(lowres);
+    if (decoderFull.open(streamInfo.videoCodecParameters) < 0
+            || decoderDetect.open(streamInfo.videoCodecParameters) < 0) {
+        std::cout << "Failed to open codec" << std::endl;
+        return -3;
+    }
+    std::cout << "detection quality, lowres: " << decoderDetect.lowres() << std::endl;
+
+    // same detection resolution for both decoders
+    MotionDetector detectorFull;
+    MotionDetector detectorDetect;
+    detectorDetect.scaleFrame(detectorFull.scaleFrame() * (1 << decoderDetect.lowres()));
+
+    PerfCounter timeFull("decode full quality in ms");
+    PerfCounter timeDetect("decode detection quality in ms");
+    AVPacket* packet = nullptr;
+    cv::Mat frameFull, frameDetect;
+    long frames = 0, motionAgree = 0;
+    double sumMad = 0, sumMse = 0, sumIntensityDiff = 0;
+
+    while (reader.readVideoPacket(packet)) {
+        timeFull.startCount();
+        bool isFrameFull = decoderFull.decodePacket(packet);
+        timeFull.stopCount();
+
+        timeDetect.startCount();
+        bool isFrameDetect = decoderDetect.decodePacket(packet);
+        timeDetect.stopCount();
+        av_packet_free(&packet);
+
+        if (!isFrameFull || !isFrameDetect)
+            continue;
+        if (!decoderFull.retrieveFrame(frameFull) || !decoderDetect.retrieveFrame(frameDetect))
+            continue;
+
+        bool isMotionFull = detectorFull.isContinuousMotion(frameFull);
+        bool isMotionDetect = detectorDetect.isContinuousMotion(frameDetect);
+
+        // compare frames at detection resolution (before blur)
+        cv::Mat a = detectorFull.resizedFrame();
+        cv::Mat b = detectorDetect.resizedFrame();
+        if (a.size() != b.size())
+            cv::resize(b, b, a.size(), 0, 0, cv::INTER_LINEAR);
+        double pixels = static_cast<double>(a.total());
+        double l2 = cv::norm(a, b, cv::NORM_L2);
+        sumMad += cv::norm(a, b, cv::NORM_L1) / pixels;
+        sumMse += l2 * l2 / pixels;
+        sumIntensityDiff += std::abs(detectorFull.motionIntensity() - detectorDetect.motionIntensity());
+        if (isMotionFull == isMotionDetect)
+            ++motionAgree;
+        ++frames;
+    }
+
+    if (frames == 0) {
+        std::cout << "no frames decoded" << std::endl;
+        return -4;
+    }
+
+    double mse = sumMse / frames;
+    timeFull.printStatistics();
+    timeDetect.printStatistics();
+    std::cout << "===================================" << std::endl
+              << "detection frames, " << frames << " frames compared" << std::endl;
+    std::cout << "mean abs diff:   " << sumMad / frames << std::endl;
+    std::cout << "psnr in dB:      " << (mse > 0 ? 10 * std::log10(255.0 * 255.0 / mse) : 99.0) << std::endl;
+    std::cout << "intensity diff:  " << sumIntensityDiff / frames << std::endl;
+    std::cout << "motion agrees:   " << 100.0 * motionAgree / frames << " %" << std::endl;
+
+    return 0;
+}
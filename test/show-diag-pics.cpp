@@ -81,7 +81,7 @@ int main_show_diag_pics(int argc, const char *argv[])
     MotionDetector detector;
     detector.bgrSubThreshold(50);       // foreground / background gray difference
     detector.minMotionDuration(30);     // consecutive frames
-    detector.minMotionIntensity(1000);
+    detector.minMotionArea(5);          // per cent of analysed area
 
     cv::VideoCapture cap;
     if (!cap.open(0)) {
@@ -126,6 +126,7 @@ int main_show_diag_pics(int argc, const char *argv[])
         sd.motionDuration = detector.motionDuration();
         sd.motionIntensity = detector.motionIntensity();
         sd.preIdx = n;
+        sd.packetScore = 0;
         diagBuffer.push(sd);
 
         if (isMotion) {
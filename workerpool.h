@@ -0,0 +1,128 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/// persistent threads for data parallel work of one frame (e.g. stripes)
+/// run(tasks, task) calls task(n) for n = 0 ... tasks - 1 and returns after all are done,
+/// the calling thread takes part: pool of size threads uses threads - 1 workers
+/// no allocation per run: task is referenced, not copied into std::function
+class WorkerPool
+{
+public:
+    WorkerPool(int threads) :
+        m_active(0),
+        m_context(nullptr),
+        m_generation(0),
+        m_invoke(nullptr),
+        m_nextTask(0),
+        m_pending(0),
+        m_tasks(0),
+        m_terminate(false)
+    {
+        for (int n = 1; n < threads; ++n)
+            m_workers.emplace_back(&WorkerPool::work, this);
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_terminate = true;
+        }
+        m_startCnd.notify_all();
+        for (auto& worker : m_workers)
+            worker.join();
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    template <class Task> void run(int tasks, Task& task)
+    {
+        if (tasks <= 0)
+            return;
+        if (m_workers.empty() || tasks == 1) {
+            for (int n = 0; n < tasks; ++n)
+                task(n);
+            return;
+        }
+        {
+            // workers of previous run may not have left yet
+            std::unique_lock<std::mutex> lock(m_mtx);
+            m_doneCnd.wait(lock, [this] { return m_active == 0; });
+            m_context = &task;
+            m_invoke = [](void* context, int n) { (*static_cast<Task*>(context))(n); };
+            m_tasks = tasks;
+            m_nextTask.store(0);
+            m_pending.store(tasks);
+            ++m_generation;
+        }
+        m_startCnd.notify_all();
+        runTasks();
+        std::unique_lock<std::mutex> lock(m_mtx);
+        m_doneCnd.wait(lock, [this] { return m_pending.load() == 0; });
+    }
+
+    int size() const
+    {
+        return static_cast<int>(m_workers.size()) + 1;
+    }
+
+private:
+    // claim tasks until none left, last finished task wakes up caller
+    void runTasks()
+    {
+        int n;
+        while ((n = m_nextTask.fetch_add(1)) < m_tasks) {
+            m_invoke(m_context, n);
+            if (m_pending.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                m_doneCnd.notify_all();
+            }
+        }
+    }
+
+    void work()
+    {
+        unsigned generation = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(m_mtx);
+                m_startCnd.wait(lock, [&] { return m_terminate || m_generation != generation; });
+                if (m_terminate)
+                    return;
+                generation = m_generation;
+                ++m_active;
+            }
+            runTasks();
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                --m_active;
+            }
+            m_doneCnd.notify_all();
+        }
+    }
+
+    int                     m_active;   // workers inside run, guarded by m_mtx
+    void*                   m_context;
+    std::condition_variable m_doneCnd;
+    unsigned                m_generation;
+    void                    (*m_invoke)(void* context, int n);
+    std::mutex              m_mtx;
+    std::atomic<int>        m_nextTask;
+    std::atomic<int>        m_pending;
+    std::condition_variable m_startCnd;
+    int                     m_tasks;
+    bool                    m_terminate;
+    char                    avoidPaddingWarning1[3];
+    std::vector<std::thread> m_workers;
+};
+
+
+#endif // WORKERPOOL_H